@@ -0,0 +1,409 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "SDL3/SDL.h" // v3.2.16
+#include "core.h"
+
+/***** beeper *****/
+
+// the chip8 buzzer as a pull source. SDL calls render() from its audio thread
+// for exactly the samples the device is about to play, so nothing piles up in
+// the stream however fast the main loop spins.
+//
+// the emulation thread never touches samples. the core logs each sound timer
+// start and stop with the instruction count it happened at, and at every
+// 60 Hz frame those edges are stamped on a guest clock counted in output
+// samples: frames are rate / FPS samples long and instruction n of a frame
+// sits n * rate / clock samples in, clock being the platform's
+// instructions/sec. the audio thread plays that
+// clock over a frame behind the emulation, so every edge is
+// known before it is due and lands on its exact (fractional) sample, with a
+// raised cosine ramp instead of a step so starts and stops don't click.
+//
+// xo-chip roms swap the beep for their own 128 bit pattern at their own pitch.
+// a pattern change goes through the same ring, stamped like an edge, and the
+// audio thread expands it once into a wavetable the size of the sine table, so
+// both voices come out of the same branch free loop over a fixed point phase.
+//
+// megachip 060n samples are mixed on top. the pcm is copied out of guest
+// memory when the sample starts, into one of a few slots so the audio thread
+// can keep playing the previous one until the start is due.
+//
+// the two clocks still drift, the wall clock paces the emulation and the
+// device crystal paces the audio. the audio side absorbs it by skipping ahead
+// or stalling (counted as overruns and underruns). in audio sync mode the
+// frontend also scales its clock by speed(), a correction of at most
+// MAX_CORRECTION that keeps the lag near its target so neither happens.
+class Beeper {
+public:
+	static const int TABLE_BITS = 10;
+	static const int TABLE_SIZE = 1 << TABLE_BITS; // one sine period
+	static const int EVENTS = 256; // ring of pending edges and pattern changes, far more than a buffer ever holds
+	static const int SAMPLE_SLOTS = 4; // megachip samples copied out but not finished playing
+	static constexpr double MAX_CORRECTION = 0.005; // +-0.5%, below what anyone hears as pitch or tempo
+
+	Beeper() {
+		for (int i = 0; i <= TABLE_SIZE; i++) table[i] = (float)std::sin(2.0 * 3.14159265358979323846 * i / TABLE_SIZE);
+		std::memset(patternWave, 0, sizeof(patternWave));
+	}
+
+	// sample rate the stream was opened with, before the device starts pulling
+	void open(int sampleRate) {
+		rate = sampleRate;
+		configure(tone, volume, attack, release);
+	}
+
+	// frequency in Hz, volume 0-1, attack and release in ms for the gain to ramp fully up or down
+	void configure(float frequency, float gain, float attackMs, float releaseMs) {
+		tone = frequency;
+		volume = gain;
+		attack = attackMs;
+		release = releaseMs;
+		increment.store((uint32_t)(SDL_clamp(frequency, 20.0f, rate / 2.0f) / rate * 4294967296.0), std::memory_order_relaxed);
+		level.store(SDL_clamp(gain, 0.0f, 1.0f), std::memory_order_relaxed);
+		attackSamples.store(SDL_max(attackMs * rate / 1000.0f, 1.0f), std::memory_order_relaxed);
+		releaseSamples.store(SDL_max(releaseMs * rate / 1000.0f, 1.0f), std::memory_order_relaxed);
+	}
+
+	// emulation thread, at every 60 Hz refresh once the frame's instructions
+	// and tick() ran. places the core's sound events inside that frame by the
+	// instruction they happened at. on is false while the machine is stopped so
+	// a held sound timer doesn't drone through a breakpoint
+	void frame(const c8ke& emu, bool on) {
+		clock = emu.clock();
+		drain(emu);
+		frameStart += (double)rate / FPS;
+		frameAt = emu.executed;
+		if (on != sounding) edge(on, frameStart);
+		published.store(frameStart, std::memory_order_release);
+
+		// pi control on a smoothed lag, a callback's worth of jitter shouldn't move
+		// the speed. the integral takes over the steady drift so the lag settles on
+		// the target instead of short of it, where a proportional term alone would
+		// need an error bigger than the margin against underruns
+		double lag = frameStart - played.load(std::memory_order_relaxed);
+		averageLag += (lag - averageLag) * 0.05;
+		double error = (averageLag - targetLag()) / ((double)rate / FPS);
+		drift = SDL_clamp(drift + error * 0.01, -1.0, 1.0);
+		correction = 1.0 - SDL_clamp(error * 0.5 + drift, -1.0, 1.0) * MAX_CORRECTION;
+	}
+
+	// emulation thread. factor for the frontend's clock in audio sync mode,
+	// above 1 when the audio is about to run dry
+	double speed() const { return correction; }
+	float lagMs() const { return (float)(averageLag * 1000.0 / rate); }
+	uint64_t underruns() const { return stalls.load(std::memory_order_relaxed); }
+	uint64_t overruns() const { return skips.load(std::memory_order_relaxed); }
+
+	static void SDLCALL callback(void* user, SDL_AudioStream* stream, int additional, int total) {
+		Beeper* beeper = (Beeper*)user;
+		float samples[256];
+		int remaining = additional / (int)sizeof(float);
+		beeper->chunk.store(remaining, std::memory_order_relaxed);
+		while (remaining > 0) {
+			int count = SDL_min(remaining, 256);
+			beeper->render(samples, count);
+			SDL_PutAudioStreamData(stream, samples, count * (int)sizeof(float));
+			remaining -= count;
+		}
+	}
+
+	// audio thread. phase accumulator over a wavetable, the top bits pick the
+	// entry and the rest interpolate to the next one. the buffer is cut into
+	// spans at every pending event, so inside a span nothing but the ramp and
+	// the clock changes from one sample to the next.
+	void render(float* out, int count) {
+		float gain = level.load(std::memory_order_relaxed);
+		double latest = published.load(std::memory_order_acquire);
+
+		// too far behind the emulation (a hitch, turbo) skips ahead, catching up
+		// after a stall (startup, a dialog) steps back so the next frames don't
+		// stall again
+		double lag = latest - position;
+		if (lag > (double)rate / FPS * MAX_LAG) {
+			resync(latest - targetLag());
+			skips.fetch_add(1, std::memory_order_relaxed);
+		} else if (stalled && lag > 0.0) {
+			resync(latest - targetLag());
+		}
+
+		int done = 0;
+		while (done < count) {
+			int span = count - done;
+			bool moving = position < latest;
+			if (moving) {
+				applyEvents(position);
+				stalled = 0;
+				span = SDL_min(span, (int)std::ceil(SDL_min(nextEvent(), latest) - position));
+			} else if (stalled == 0 && latest > 0.0) {
+				stalls.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			// the main thread stopped publishing for 100ms, fade out instead of droning on
+			float fade = (stalled > rate / 10 ? -1.0f : 1.0f) / (rate * 0.01f);
+			double advance = moving ? 1.0 : 0.0;
+			const float* wave = patternVoice ? patternWave : table;
+			uint32_t step = patternVoice ? patternStep : increment.load(std::memory_order_relaxed);
+
+			for (int i = done; i < done + span; i++) {
+				duck = SDL_clamp(duck + fade, 0.0f, 1.0f);
+				float envelope = ramp(position) * duck;
+				position += advance;
+				uint32_t index = phase >> (32 - TABLE_BITS);
+				float fraction = (float)(phase & ((1u << (32 - TABLE_BITS)) - 1)) / (float)(1u << (32 - TABLE_BITS));
+				float sample = wave[index] + (wave[index + 1] - wave[index]) * fraction;
+				out[i] = (sample * envelope + pcm(moving) * duck) * gain;
+				phase += step;
+			}
+
+			if (!moving) stalled += span;
+			done += span;
+		}
+		played.store(position, std::memory_order_relaxed);
+	}
+
+private:
+	static const int MAX_LAG = 4; // frames the audio may fall behind before skipping ahead
+
+	enum Kind : byte { GATE, VOICE, SAMPLE };
+
+	struct Event {
+		double time; // guest clock, in samples
+		Kind kind;
+		bool on; // GATE: sound timer running, VOICE: the pattern replaces the beep, SAMPLE: playing
+		uint32_t step; // VOICE: phase increment for one pass over the pattern, SAMPLE: 16.16 pcm samples per output sample
+		byte bits[PATTERN_SIZE]; // VOICE
+		byte slot; // SAMPLE
+		bool loop; // SAMPLE
+		uint32_t length; // SAMPLE, in bytes
+	};
+
+	// emulation thread. the pattern and sample come from the machine as it is
+	// at the end of the frame, only the gate carries its own value. a reader
+	// that fell a whole ring behind, or a machine that went back in time with
+	// step back, takes the current state instead
+	void drain(const c8ke& emu) {
+		if (emu.soundHead - consumed > (uint32_t)SOUND_EVENTS) {
+			consumed = emu.soundHead;
+			double now = stamp(emu.executed);
+			if ((emu.soundReg > 0) != sounding) edge(emu.soundReg > 0, now);
+			voice(emu, emu.pitch, now);
+			if (emu.sampleId != sampleId) sample(emu, now);
+			return;
+		}
+		for (; consumed != emu.soundHead; consumed++) {
+			const SoundEvent& e = emu.soundEvents[consumed % SOUND_EVENTS];
+			double time = stamp(e.at);
+			if (e.kind == SOUND_GATE) { if ((e.value > 0) != sounding) edge(e.value > 0, time); }
+			else if (e.kind == SOUND_VOICE) voice(emu, e.value, time);
+			else if (e.value != sampleId) sample(emu, time);
+		}
+		// a start that found no free slot is still pending, try again
+		if (emu.sampleId != sampleId) sample(emu, stamp(emu.executed));
+	}
+
+	// emulation thread
+	void edge(bool on, double time) {
+		sounding = on;
+		Event e = { time, GATE, on };
+		push(e);
+	}
+
+	// emulation thread. 128 samples make one pass over the table, so the pass
+	// rate is the pattern's sample rate / 128
+	void voice(const c8ke& emu, byte pitch, double time) {
+		double samplesPerSecond = 4000.0 * std::pow(2.0, (pitch - 64) / 48.0);
+		Event e = { time, VOICE, emu.usesPattern, (uint32_t)(samplesPerSecond / (PATTERN_SIZE * 8) / rate * 4294967296.0) };
+		std::memcpy(e.bits, emu.pattern, PATTERN_SIZE);
+		push(e);
+	}
+
+	// emulation thread. a slot is free once the audio thread moved past every
+	// event that refers to it and isn't playing it. when none is, sampleId
+	// stays behind and drain() retries the start at the end of every frame
+	// until the audio thread frees one
+	void sample(const c8ke& emu, double time) {
+		Event e = { time, SAMPLE, emu.samplePlaying && emu.sampleLength > 0 && emu.sampleRate > 0 };
+		if (e.on) {
+			uint32_t tail = eventTail.load(std::memory_order_acquire);
+			int slot = -1;
+			for (int i = 0; i < SAMPLE_SLOTS && slot < 0; i++) {
+				if (i != playingSlot.load(std::memory_order_relaxed) && (int32_t)(slotEvent[i] - tail) < 0) slot = i;
+			}
+			if (slot < 0) return;
+
+			emu.mem.copyTo(samples[slot], emu.sampleAddress, emu.sampleLength);
+			slotEvent[slot] = eventHead.load(std::memory_order_relaxed);
+			e.slot = (byte)slot;
+			e.loop = emu.sampleLoop;
+			e.length = emu.sampleLength;
+			e.step = (uint32_t)((double)emu.sampleRate / rate * 65536.0);
+		}
+		sampleId = emu.sampleId;
+		push(e);
+	}
+
+	// emulation thread, guest clock of an instruction in the frame being drained
+	double stamp(uint64_t at) const {
+		double offset = at > frameAt ? (at - frameAt) * (double)rate / clock : 0.0;
+		return frameStart + SDL_min(offset, (double)rate / FPS);
+	}
+
+	void push(const Event& e) {
+		uint32_t head = eventHead.load(std::memory_order_relaxed);
+		if (head - eventTail.load(std::memory_order_acquire) >= EVENTS) return; // audio isn't pulling, nothing to be late for
+		events[head % EVENTS] = e;
+		eventHead.store(head + 1, std::memory_order_release);
+	}
+
+	// how far the audio trails the emulation: a frame is published at a time and
+	// a callback renders a chunk at once, half a frame more is margin for jitter
+	double targetLag() const {
+		return (double)rate / FPS * 1.5 + chunk.load(std::memory_order_relaxed);
+	}
+
+	// audio thread, moves the clock and the ramp with it so the gain doesn't jump
+	void resync(double to) {
+		rampStart += to - position;
+		position = to;
+		stalled = 0;
+	}
+
+	// audio thread, takes every event due by the sample at `now`
+	void applyEvents(double now) {
+		uint32_t tail = eventTail.load(std::memory_order_relaxed);
+		while (tail != eventHead.load(std::memory_order_acquire) && events[tail % EVENTS].time <= now) {
+			const Event& e = events[tail % EVENTS];
+			if (e.kind == VOICE) applyVoice(e);
+			else if (e.kind == SAMPLE) applySample(e);
+			else if (e.on != target) startRamp(SDL_max(e.time, now - 1.0), e.on);
+			tail++;
+		}
+		eventTail.store(tail, std::memory_order_release);
+	}
+
+	// audio thread, guest clock of the next pending event
+	double nextEvent() const {
+		uint32_t tail = eventTail.load(std::memory_order_relaxed);
+		if (tail == eventHead.load(std::memory_order_acquire)) return INFINITY;
+		return events[tail % EVENTS].time;
+	}
+
+	// audio thread. each pattern bit becomes TABLE_SIZE / 128 table entries, so
+	// interpolation only softens the last eighth of a bit into the next one.
+	// +-0.7 gives the square about the loudness of the full scale sine.
+	void applyVoice(const Event& e) {
+		patternVoice = e.on;
+		patternStep = e.step;
+		const int perBit = TABLE_SIZE / (PATTERN_SIZE * 8);
+		for (int i = 0; i < TABLE_SIZE; i++) {
+			int bit = i / perBit;
+			int set = (e.bits[bit >> 3] >> (7 - (bit & 7))) & 1;
+			patternWave[i] = (float)(set * 2 - 1) * 0.7f;
+		}
+		patternWave[TABLE_SIZE] = patternWave[0];
+	}
+
+	// audio thread, before the tail moves past the event so the slot reads as busy
+	void applySample(const Event& e) {
+		pcmSlot = e.on ? e.slot : -1;
+		pcmLength = e.on ? e.length : 0;
+		pcmLoop = e.loop;
+		pcmStep = e.step;
+		pcmPosition = 0;
+		playingSlot.store(pcmSlot, std::memory_order_relaxed);
+	}
+
+	// audio thread, the next sample of the megachip voice. 8 bit unsigned,
+	// interpolated between neighbours, and it only moves with the guest clock
+	float pcm(bool advance) {
+		if (!pcmLength) return 0.0f;
+		const byte* data = samples[pcmSlot];
+		uint32_t i = (uint32_t)(pcmPosition >> 16);
+		uint32_t next = (i + 1 < pcmLength) ? i + 1 : (pcmLoop ? 0 : i);
+		float fraction = (float)(pcmPosition & 0xFFFF) / 65536.0f;
+		float value = (data[i] + (data[next] - data[i]) * fraction - 128.0f) / 128.0f;
+		if (advance) {
+			pcmPosition += pcmStep;
+			if ((pcmPosition >> 16) >= pcmLength) {
+				if (pcmLoop) pcmPosition %= (uint64_t)pcmLength << 16;
+				else pcmLength = 0;
+			}
+		}
+		return value;
+	}
+
+	void startRamp(double time, bool on) {
+		uint32_t step = patternVoice ? patternStep : increment.load(std::memory_order_relaxed);
+		if (on && ramp(time) == 0.0f) phase = (uint32_t)((position - time) * step); // wave starts exactly at the edge
+		from = ramp(time);
+		target = on;
+		rampStart = time;
+		rampRate = 1.0 / (on ? attackSamples.load(std::memory_order_relaxed) : releaseSamples.load(std::memory_order_relaxed));
+	}
+
+	// gain at a point of the guest clock, sin^2 from `from` to the target so the
+	// edge has no corner for the ear to hear as a click. clamped rather than
+	// tested, it runs for every sample
+	float ramp(double time) const {
+		float x = (float)SDL_clamp((time - rampStart) * rampRate, 0.0, 1.0);
+		float s = table[(int)(x * (TABLE_SIZE / 4))]; // first quarter of the sine, 0 to 1
+		return from + ((float)target - from) * s * s;
+	}
+
+	float table[TABLE_SIZE + 1]; // one extra entry so interpolation never wraps
+	float patternWave[TABLE_SIZE + 1]; // audio thread, the expanded xo-chip pattern
+	byte samples[SAMPLE_SLOTS][MAX_MEM]; // megachip pcm, written by the emulation thread while its slot is free
+	int rate = 48000;
+	float tone = 2200.0f, volume = 0.5f, attack = 4.0f, release = 8.0f; // last configure(), for open()
+
+	// emulation thread only
+	double frameStart = 0.0; // guest clock at the start of the current frame
+	uint64_t frameAt = 0; // c8ke::executed at its start
+	uint32_t consumed = 0; // c8ke::soundHead as of the last drain
+	unsigned short clock = QUIRKS[CHIP8].clock; // instructions/sec of the running platform
+	bool sounding = false; // sound timer state as of the last edge
+	byte sampleId = 0; // c8ke::sampleId as of the last SAMPLE event
+	uint32_t slotEvent[SAMPLE_SLOTS] = { UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX }; // ring index of the last event using each slot
+	double averageLag = 0.0; // samples between published and played
+	double drift = 0.0; // integral term, in units of MAX_CORRECTION
+	double correction = 1.0;
+
+	// shared, written by the emulation thread
+	std::atomic<uint32_t> increment{ 0 };
+	std::atomic<float> level{ 0.5f };
+	std::atomic<float> attackSamples{ 1.0f };
+	std::atomic<float> releaseSamples{ 1.0f };
+	std::atomic<double> published{ 0.0 }; // guest clock up to which every event is known
+	Event events[EVENTS];
+	std::atomic<uint32_t> eventHead{ 0 };
+	std::atomic<uint32_t> eventTail{ 0 };
+
+	// shared, written by the audio thread
+	std::atomic<double> played{ 0.0 }; // guest clock rendered so far
+	std::atomic<int> chunk{ 0 }; // samples asked for by the last callback
+	std::atomic<int> playingSlot{ -1 };
+	std::atomic<uint64_t> stalls{ 0 };
+	std::atomic<uint64_t> skips{ 0 };
+
+	// audio thread only
+	double position = 0.0; // guest clock of the next sample
+	int stalled = 0; // samples rendered without the clock moving
+	float duck = 1.0f; // fades everything while stalled
+	uint32_t phase = 0;
+	bool patternVoice = false; // playing patternWave instead of the sine
+	uint32_t patternStep = 0;
+	bool target = false; // where the current ramp is headed
+	float from = 0.0f; // gain the ramp started at
+	double rampStart = 0.0;
+	double rampRate = 1.0; // 1 / ramp length in samples
+	int pcmSlot = -1;
+	uint32_t pcmLength = 0; // 0 while no sample plays
+	bool pcmLoop = false;
+	uint32_t pcmStep = 0;
+	uint64_t pcmPosition = 0; // 16.16 into the slot
+};
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+#include "core.h"
+#include "condition.h"
+
+/***** breakpoints *****/
+
+// pc breakpoints plus read/write watchpoints on memory and registers. every
+// address kind is a MAX_MEM bit bitmap, so a check is one shift and mask, and the
+// frontend only runs the instrumented core while something is set, so with no
+// breakpoints the loop is the same plain cycle() as before. pc breakpoints can
+// carry a compiled condition, looked up only once the bitmap says there's a hit.
+struct Breakpoints : NoProbe {
+	struct Conditional {
+		Condition condition;
+		uint64_t hits = 0; // bitmap hits, whether the condition held or not
+	};
+
+	enum Kind { EXEC, READ, WRITE, KINDS };
+	static const int I_REG = 16; // watchRegister() index for I
+
+	uint64_t bits[KINDS][MAX_MEM / 64]{};
+	uint32_t watched = 0; // bit n = Vn, bit 16 = I
+	bool triggered = false; // set by the hooks, cleared by takeTrigger()
+	char reason[64] = "";
+	std::unordered_map<word, Conditional> conditions; // by pc, only for exec breakpoints
+
+	bool any() const { return count > 0 || watched != 0; }
+
+	bool test(Kind kind, word address) const {
+		address &= MAX_MEM - 1;
+		return (bits[kind][address >> 6] >> (address & 63)) & 1;
+	}
+
+	void set(Kind kind, word address, bool on) {
+		address &= MAX_MEM - 1;
+		if (kind == EXEC && !on) conditions.erase(address);
+		if (test(kind, address) == on) return;
+		bits[kind][address >> 6] ^= 1ull << (address & 63);
+		count += on ? 1 : -1;
+	}
+
+	// exec breakpoint that only stops when the expression is nonzero, an empty
+	// expression makes it unconditional again
+	bool setCondition(word address, const std::string& expression, std::string& error) {
+		address &= MAX_MEM - 1;
+		if (expression.find_first_not_of(" \t") == std::string::npos) {
+			conditions.erase(address);
+			set(EXEC, address, true);
+			return true;
+		}
+
+		Conditional conditional;
+		if (!conditional.condition.compile(expression, error)) return false;
+		conditions[address] = std::move(conditional);
+		set(EXEC, address, true);
+		return true;
+	}
+
+	void watchRegister(int reg, bool on, const c8ke& emu) {
+		if (on) watched |= 1u << reg;
+		else watched &= ~(1u << reg);
+		sync(emu);
+	}
+
+	void clear() {
+		std::memset(bits, 0, sizeof(bits));
+		conditions.clear();
+		watched = 0;
+		count = 0;
+		skip = false;
+		triggered = false;
+	}
+
+	// register watches compare against the last seen values, call after anything
+	// outside cycle() changed the machine (reset, reload)
+	void sync(const c8ke& emu) {
+		std::memcpy(lastRegs, emu.regs, sizeof(lastRegs));
+		lastI = emu.iReg;
+	}
+
+	// checked before each cycle, the instruction at a breakpoint hasn't run yet
+	bool shouldBreak(const c8ke& emu) {
+		if (skip) { skip = false; return false; }
+		word pc = emu.pc & (MAX_MEM - 1);
+		if (!test(EXEC, pc)) return false;
+
+		auto found = conditions.find(pc);
+		if (found != conditions.end()) {
+			Conditional& conditional = found->second;
+			conditional.hits++;
+			if (!conditional.condition.evaluate(emu, conditional.hits)) return false;
+			std::snprintf(reason, sizeof(reason), "0x%03X: %.40s", pc, conditional.condition.text.c_str());
+			return true;
+		}
+
+		std::snprintf(reason, sizeof(reason), "breakpoint at 0x%03X", pc);
+		return true;
+	}
+
+	// lets the next instruction run even if it sits on a breakpoint
+	void resume() {
+		skip = true;
+		triggered = false;
+	}
+
+	// fresh run state for replaying on a copy, the breakpoints themselves stay
+	void restart() {
+		skip = false;
+		triggered = false;
+	}
+
+	bool takeTrigger() {
+		bool hit = triggered;
+		triggered = false;
+		return hit;
+	}
+
+	void execute(word pc, word instruction) {
+		this->pc = pc;
+	}
+
+	void read(word address, word count) {
+		access(READ, "read", address, count);
+	}
+
+	void write(word address, word count) {
+		access(WRITE, "write", address, count);
+	}
+
+	void retire(const c8ke& emu) {
+		if (!watched) return;
+		for (int i = 0; i < 16; i++) {
+			if ((watched & (1u << i)) && emu.regs[i] != lastRegs[i]) {
+				hit("V%X %02X -> %02X at 0x%03X", i, lastRegs[i], emu.regs[i], pc);
+				break;
+			}
+		}
+		if ((watched & (1u << I_REG)) && emu.iReg != lastI) hit("I %03X -> %03X at 0x%03X", lastI, emu.iReg, pc);
+		sync(emu);
+	}
+
+private:
+	void access(Kind kind, const char* name, word address, word count) {
+		for (word i = 0; i < count; i++) {
+			word a = (address + i) & (MAX_MEM - 1);
+			if (test(kind, a)) {
+				hit("%s 0x%03X at 0x%03X", name, a, pc);
+				return;
+			}
+		}
+	}
+
+	template <class... Args>
+	void hit(const char* format, Args... args) {
+		if (triggered) return; // first watchpoint of the instruction wins
+		triggered = true;
+		std::snprintf(reason, sizeof(reason), format, args...);
+	}
+
+	int count = 0; // bits set over all kinds
+	bool skip = false;
+	word pc = 0; // instruction currently running
+	byte lastRegs[16]{};
+	word lastI = 0;
+};
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "core.h"
+#include "profiler.h"
+#include "trace.h"
+
+// offline reader for the traces written by c8ke --trace and Debug > Start Trace
+
+
+
+/***** helper functions *****/
+
+void usage() {
+	std::cerr << "usage: c8ke-trace dump FILE [filters]\n"
+		"       c8ke-trace stats FILE [filters]\n"
+		"       c8ke-trace diff FILE FILE [--context N]\n"
+		"filters:\n"
+		"  --from N            skip instructions before cycle N\n"
+		"  --to N              stop after cycle N\n"
+		"  --pc ADDR[-ADDR]    only instructions fetched in this address range\n"
+		"  --op NAME           only this opcode class, e.g. Dxyn or 8xy4\n"
+		"  --reg N             only instructions that changed Vn\n";
+}
+
+struct Filter {
+	uint64_t from = 0;
+	uint64_t to = UINT64_MAX;
+	word pcLow = 0;
+	word pcHigh = 0xFFFF;
+	int opcode = -1; // OpcodeClass, -1 for any
+	int reg = -1;
+
+	bool matches(const TraceEntry& entry) const {
+		if (entry.cycle < from || entry.cycle > to) return false;
+		if (entry.pc < pcLow || entry.pc > pcHigh) return false;
+		if (opcode >= 0 && opcodeClass(entry.instruction) != opcode) return false;
+		if (reg >= 0 && !(entry.changed & (1 << reg))) return false;
+		return true;
+	}
+};
+
+// one line per instruction, registers are only listed when they changed
+void print(const TraceEntry& entry, const char* prefix = "") {
+	char line[160];
+	int length = std::snprintf(line, sizeof(line), "%s%10llu  %03X  %04X  %-4s  I=%03X", prefix, (unsigned long long)entry.cycle,
+		entry.pc, entry.instruction, opcodeNames[opcodeClass(entry.instruction)], entry.iReg);
+	for (int i = 0; i < 16 && length < (int)sizeof(line) - 8; i++) {
+		if (entry.changed & (1 << i)) length += std::snprintf(line + length, sizeof(line) - length, "  V%X=%02X", i, entry.regs[i]);
+	}
+	std::cout << line << '\n';
+}
+
+bool sameState(const TraceEntry& a, const TraceEntry& b) {
+	return a.pc == b.pc && a.instruction == b.instruction && a.iReg == b.iReg && std::memcmp(a.regs, b.regs, sizeof(a.regs)) == 0;
+}
+
+
+
+/***** commands *****/
+
+int dump(TraceReader& reader, const Filter& filter) {
+	TraceEntry entry;
+	while (reader.next(entry)) {
+		if (entry.cycle > filter.to) break;
+		if (filter.matches(entry)) print(entry);
+	}
+	return 0;
+}
+
+int stats(TraceReader& reader, const Filter& filter) {
+	uint64_t matched = 0, first = 0, last = 0;
+	uint64_t opcodes[OPCODE_CLASSES]{};
+	uint64_t writes[16]{};
+
+	TraceEntry entry;
+	while (reader.next(entry)) {
+		if (entry.cycle > filter.to) break;
+		if (!filter.matches(entry)) continue;
+		if (!matched++) first = entry.cycle;
+		last = entry.cycle;
+		opcodes[opcodeClass(entry.instruction)]++;
+		for (int i = 0; i < 16; i++) if (entry.changed & (1 << i)) writes[i]++;
+	}
+
+	std::cout << matched << " instructions";
+	if (matched) std::cout << ", cycles " << first << " to " << last;
+	std::cout << '\n';
+	for (int i = 0; i < OPCODE_CLASSES; i++) {
+		if (opcodes[i]) std::printf("  %-4s  %12llu  %6.2f%%\n", opcodeNames[i], (unsigned long long)opcodes[i], 100.0 * opcodes[i] / matched);
+	}
+	for (int i = 0; i < 16; i++) {
+		if (writes[i]) std::printf("  V%X    %12llu writes\n", i, (unsigned long long)writes[i]);
+	}
+	return 0;
+}
+
+// walks both traces in lockstep and stops at the first instruction where the
+// machines disagree, with the shared history before it for context
+int diff(TraceReader& a, TraceReader& b, size_t context) {
+	std::deque<TraceEntry> history;
+	TraceEntry left, right;
+	uint64_t compared = 0;
+
+	for (;;) {
+		bool hasLeft = a.next(left);
+		bool hasRight = b.next(right);
+		if (!hasLeft && !hasRight) {
+			std::cout << "traces match, " << compared << " instructions\n";
+			return 0;
+		}
+
+		if (hasLeft != hasRight || !sameState(left, right)) {
+			std::cout << "traces diverge after " << compared << " instructions\n";
+			for (const TraceEntry& entry : history) print(entry, "  ");
+			if (hasLeft) print(left, "< ");
+			else std::cout << "< end of trace\n";
+			if (hasRight) print(right, "> ");
+			else std::cout << "> end of trace\n";
+			return 1;
+		}
+
+		compared++;
+		if (context) {
+			if (history.size() == context) history.pop_front();
+			history.push_back(left);
+		}
+	}
+}
+
+
+
+/***** main functions *****/
+
+int main(int argc, char* args[]) {
+	if (argc < 3) { usage(); return 2; }
+
+	std::string command = args[1];
+	std::vector<std::string> files;
+	Filter filter;
+	size_t context = 8;
+
+	try {
+		for (int i = 2; i < argc; i++) {
+			std::string arg = args[i];
+			bool hasValue = i + 1 < argc;
+
+			if (arg == "--from" && hasValue) filter.from = std::stoull(args[++i]);
+			else if (arg == "--to" && hasValue) filter.to = std::stoull(args[++i]);
+			else if (arg == "--pc" && hasValue) {
+				std::string range = args[++i];
+				size_t dash = range.find('-');
+				filter.pcLow = (word)std::stoul(range.substr(0, dash), nullptr, 16);
+				filter.pcHigh = (dash == std::string::npos) ? filter.pcLow : (word)std::stoul(range.substr(dash + 1), nullptr, 16);
+			} else if (arg == "--op" && hasValue) {
+				std::string name = args[++i];
+				for (int op = 0; op < OPCODE_CLASSES; op++) {
+					if (name.size() == 4 && std::equal(name.begin(), name.end(), opcodeNames[op], [](char x, char y) { return std::tolower(x) == std::tolower(y); })) filter.opcode = op;
+				}
+				if (filter.opcode < 0) { std::cerr << "c8ke-trace - Unknown opcode class " << name << std::endl; return 2; }
+			} else if (arg == "--reg" && hasValue) filter.reg = std::stoi(args[++i], nullptr, 16) & 0xF;
+			else if (arg == "--context" && hasValue) context = std::stoul(args[++i]);
+			else if (!arg.empty() && arg[0] != '-') files.push_back(arg);
+			else { usage(); return 2; }
+		}
+	} catch (const std::exception&) { // bad number
+		usage();
+		return 2;
+	}
+
+	size_t needed = (command == "diff") ? 2 : 1;
+	if (files.size() != needed) { usage(); return 2; }
+
+	TraceReader first, second;
+	if (!first.open(files[0])) { std::cerr << "c8ke-trace - Error opening trace file " << files[0] << std::endl; return 2; }
+	if (command == "dump") return dump(first, filter);
+	if (command == "stats") return stats(first, filter);
+	if (command == "diff") {
+		if (!second.open(files[1])) { std::cerr << "c8ke-trace - Error opening trace file " << files[1] << std::endl; return 2; }
+		return diff(first, second, context);
+	}
+
+	usage();
+	return 2;
+}
@@ -8,6 +8,9 @@
 #include <ios>
 #include <unordered_map>
 #include <cstring>
+#include <vector>
+#include <functional>
+#include <stdexcept>
 
 #include "SDL3/SDL.h" // v3.2.16
 #include "SDL3/SDL_main.h" // v3.2.16
@@ -18,6 +21,21 @@
 #include "ImGui/imgui_internal.h" // v1.92.0
 #include "tinyfiledialogs/tinyfiledialogs.h" // v3.19.1
 
+#include "core.h"
+#include "profiler.h"
+#include "sampler.h"
+#include "trace.h"
+#include "timeline.h"
+#include "perf.h"
+#include "heatmap.h"
+#include "breakpoints.h"
+#include "history.h"
+#include "disasm.h"
+#include "gdb.h"
+#include "shm.h"
+#include "audio.h"
+#include "video.h"
+#include "vip.h"
 #include "c8ke.h"
 
 
@@ -56,10 +74,16 @@ static void Settings_ReadLine(ImGuiContext*, ImGuiSettingsHandler*, void* user_d
 	CustomAudio* audioSettings = (CustomAudio*)user_data;
 	int val;
 
-	if (sscanf_s(line, "beepAmount=%d", &val) == 1)
-		audioSettings->beepAmount = val;
-	else if (sscanf_s(line, "beepPhase=%d", &val) == 1)
-		audioSettings->beepPhase = val;
+	if (sscanf_s(line, "tone=%d", &val) == 1)
+		audioSettings->tone = val;
+	else if (sscanf_s(line, "volume=%d", &val) == 1)
+		audioSettings->volume = val;
+	else if (sscanf_s(line, "attack=%d", &val) == 1)
+		audioSettings->attack = val;
+	else if (sscanf_s(line, "release=%d", &val) == 1)
+		audioSettings->release = val;
+	else if (sscanf_s(line, "sync=%d", &val) == 1)
+		audioSettings->sync = val != 0;
 
 }
 
@@ -79,273 +103,90 @@ static void Settings_WriteAll(ImGuiContext*, ImGuiSettingsHandler* handler, ImGu
 
 	const CustomAudio& a = customAudio;
 	out_buf->appendf("[%s][Audio]\n", handler->TypeName);
-	out_buf->appendf("beepAmount=%d\n", a.beepAmount);
-	out_buf->appendf("beepPhase=%d\n", a.beepPhase);
+	out_buf->appendf("tone=%d\n", a.tone);
+	out_buf->appendf("volume=%d\n", a.volume);
+	out_buf->appendf("attack=%d\n", a.attack);
+	out_buf->appendf("release=%d\n", a.release);
+	out_buf->appendf("sync=%d\n", a.sync ? 1 : 0);
 }
 
-SDL_Keycode findSDLKeycode(byte chip8Key) {
-	for (const auto& [keycode, val] : keymap) {
-		if (val == chip8Key)
-			return keycode;
-	}
-	return SDLK_UNKNOWN;
+uint64_t newSeed() { // random unless a seed was given on the command line
+	if (options.hasSeed) return options.seed;
+	return static_cast<uint64_t>(std::chrono::high_resolution_clock::now().time_since_epoch().count());
 }
 
-void clear() {
-	for (int y = 0; y < HEIGHT; y++) {
-		for (int x = 0; x < WIDTH; x++) {
-			screen[y][x] = 0;
-		}
-	}
+void usage() {
+	std::cerr << "usage: c8ke [rom] [options]\n"
+		"  --headless          run without a window as fast as possible\n"
+		"  --frames N          frames to run headless (default 3600)\n"
+		"  --inputs FILE       key masks for headless runs, one hex value per frame\n"
+		"  --seed N            seed for the random number generator\n"
+		"  --platform NAME     chip8, chip48, schip, xochip or megachip (default: from the extension and the code)\n"
+		"  --vip-timing        run chip8 roms at the cosmac vip's per instruction speed\n"
+		"  --vip-rom FILE      cosmac vip monitor rom image, for --lle and --oracle\n"
+		"  --vip-interpreter FILE  original chip8 interpreter image, for --lle and --oracle\n"
+		"  --lle               run headless on an emulated cosmac vip and its interpreter\n"
+		"  --oracle            run headless, checking the core against the emulated vip\n"
+		"  --sample N          sample the guest call stack every N cycles\n"
+		"  --folded FILE       write sampled stacks in folded format\n"
+		"  --pprof FILE        write sampled stacks as a pprof profile\n"
+		"  --trace FILE        write every executed instruction to a trace file\n"
+		"  --timeline FILE     record host timing zones, written as chrome trace json on exit\n"
+		"  --coverage FILE     write a map of the rom bytes executed, read and written\n"
+		"  --gdb PORT          serve the gdb remote protocol on localhost (not headless)\n"
+		"  --shm NAME          publish registers, memory and screen every frame in shared memory\n";
 }
 
+Platform platformNamed(const std::string& name) {
+	const char* const names[PLATFORMS] = { "chip8", "chip48", "schip", "xochip", "megachip" };
+	for (int p = 0; p < PLATFORMS; p++) if (name == names[p]) return (Platform)p;
+	if (name != "auto") throw std::invalid_argument(name);
+	return AUTO;
+}
 
-
-/***** emulator core *****/
-
-struct c8ke {
-	word instruction{}; // current instruction
-	word pc{}; // 16-bit program counter
-	byte sp{}; // 8-bit stack pointer
-
-	word stack[16]{}; // 16 16-bit values
-	byte regs[16]{}; // 16 8-bit registers
-	byte mem[MAX_MEM]{}; // program memory
-
-	word iReg{}; // 16-bit i register
-	byte delayReg{}; // 8-bit delay timer register
-	byte soundReg{}; // 8-bit sound timer register
-
-	void reset() {
-		// reset values
-		pc = START_ADDRESS;
-		sp = -1;
-		iReg = 0;
-		delayReg = 0;
-		soundReg = 0;
-		for (byte i = 0; i < 16; i++) {
-			stack[i] = 0;
-			regs[i] = 0;
-		}
-		std::memset(mem, 0, sizeof(mem));
-
-		// load sprites into memory
-		for (int i = 0; i < TOTAL_SPRITE_SIZE; i++) {
-			mem[SPRITE_ADDRESS + i] = sprites[i];
+void parseArgs(int argc, char* args[]) {
+	try {
+		for (int i = 1; i < argc; i++) {
+			std::string arg = args[i];
+			bool hasValue = i + 1 < argc;
+
+			if (arg == "--headless") options.headless = true;
+			else if (arg == "--frames" && hasValue) options.frames = std::stoll(args[++i]);
+			else if (arg == "--inputs" && hasValue) options.inputsPath = args[++i];
+			else if (arg == "--seed" && hasValue) { options.seed = std::stoull(args[++i], nullptr, 0); options.hasSeed = true; }
+			else if (arg == "--sample" && hasValue) options.sampleInterval = (uint32_t)std::stoul(args[++i]);
+			else if (arg == "--folded" && hasValue) options.foldedPath = args[++i];
+			else if (arg == "--pprof" && hasValue) options.pprofPath = args[++i];
+			else if (arg == "--trace" && hasValue) options.tracePath = args[++i];
+			else if (arg == "--timeline" && hasValue) options.timelinePath = args[++i];
+			else if (arg == "--coverage" && hasValue) options.coveragePath = args[++i];
+			else if (arg == "--gdb" && hasValue) options.gdbPort = (uint16_t)std::stoul(args[++i]);
+			else if (arg == "--shm" && hasValue) options.shmName = args[++i];
+			else if (arg == "--platform" && hasValue) options.platform = platformNamed(args[++i]);
+			else if (arg == "--vip-timing") options.vipTiming = true;
+			else if (arg == "--vip-rom" && hasValue) options.vipRomPath = args[++i];
+			else if (arg == "--vip-interpreter" && hasValue) options.vipInterpreterPath = args[++i];
+			else if (arg == "--lle") options.lle = options.headless = true;
+			else if (arg == "--oracle") options.oracle = options.headless = true;
+			else if (!arg.empty() && arg[0] != '-' && romPath.empty()) romPath = arg;
+			else { usage(); exit(1); }
 		}
-
-		// signal in init state
-		c8keState = INIT;
+	} catch (const std::exception&) { // bad number or platform
+		usage();
+		exit(1);
 	}
 
-	void loadRom(std::string path) {
-		std::ifstream rom(path, std::ios::binary); // open file in binary mode
-		if (!rom.is_open()) {
-			std::cerr << "c8ke - Error opening rom file" << std::endl;
-			exit(1);
-		}
-
-		byte byte;
-		while (rom.read(reinterpret_cast<char*>(&byte), sizeof(byte))) { // read each line until there are no more lines
-			mem[pc++] = byte;
-		}
-
-		pc = START_ADDRESS;
-		rom.close();
-		c8keState = RUNNING;
-	}
-
-	void cycle() {
-		instruction = (mem[pc] << 8) | mem[pc + 1];
-		pc += 2;
-
-		switch (instruction & 0xF000) { // checks the first nibble
-		case 0x0000: { // 00E*
-			switch (instruction & 0x000F) {
-			case 0x0: // 00E0: clear the display
-				clear();
-				break;
-			case 0xE: // 00EE: return from a subroutine
-				pc = stack[sp];
-				sp--;
-				break;
-			}
-		} break;
-
-		case 0x1000: { // 1nnn: jump to location nnn
-			pc = instruction & 0x0FFF;
-		} break;
-
-		case 0x2000: { // 2nnn: call subroutine at nnn
-			sp++;
-			stack[sp] = pc;
-			pc = instruction & 0x0FFF;
-		} break;
-
-		case 0x3000: { // 3xkk: skip next instruction if Vx = kk
-			if (regs[(instruction & 0x0F00) >> 8] == (instruction & 0x00FF)) pc += 2;
-		} break;
-
-		case 0x4000: { // 4xkk: skip next instruction if Vx != kk
-			if (regs[(instruction & 0x0F00) >> 8] != (instruction & 0x00FF)) pc += 2;
-		} break;
-
-		case 0x5000: { // 5xy0: skip next instruction if Vx = Vy
-			if (regs[(instruction & 0x0F00) >> 8] == regs[(instruction & 0x00F0) >> 4]) pc += 2;
-		} break;
-
-		case 0x6000: { // 6xkk: set Vx = kk
-			regs[(instruction & 0x0F00) >> 8] = (instruction & 0x00FF);
-		} break;
-
-		case 0x7000: { // 7xkk: set Vx = Vx + kk
-			regs[(instruction & 0x0F00) >> 8] += (instruction & 0x00FF);
-		} break;
-
-		case 0x8000: { // 8xy*
-			byte x = (instruction & 0x0F00) >> 8;
-			byte y = (instruction & 0x00F0) >> 4;
-			switch (instruction & 0x000F) {
-			case 0x0: // 8xy0: set Vx = Vy
-				regs[x] = regs[y];
-				break;
-			case 0x1: // 8xy1: set Vx = Vx OR Vy
-				regs[x] |= regs[y];
-				regs[0xF] = 0;
-				break;
-			case 0x2: // 8xy2: set Vx = Vx AND Vy
-				regs[x] &= regs[y];
-				regs[0xF] = 0;
-				break;
-			case 0x3: // 8xy3: set Vx = Vx XOR Vy
-				regs[x] ^= regs[y];
-				regs[0xF] = 0;
-				break;
-			case 0x4: { // 8xy4: set Vx = Vx + Vy, set VF = carry
-				word sum = regs[x] + regs[y];
-				regs[x] = sum & 0xFF;
-				regs[0xF] = (sum > 0xFF) ? 1 : 0;
-			} break;
-			case 0x5: {// 8xy5: set Vx = Vx - Vy, set VF = NOT borrow
-				byte originalX = regs[x];
-				regs[x] -= regs[y];
-				regs[0xF] = (originalX >= regs[y]) ? 1 : 0;
-			} break;
-			case 0x6: {// 8xy6: set Vx = Vx SHR 1
-				byte lsb = regs[y] & 0x1;
-				regs[x] = regs[y];
-				regs[x] >>= 1;
-				regs[0xF] = lsb;
-			} break;
-			case 0x7: { // 8xy7: set Vx = Vy - Vx, set VF = NOT borrow
-				byte originalX = regs[x];
-				regs[x] = regs[y] - regs[x];
-				regs[0xF] = (regs[y] >= originalX) ? 1 : 0;
-			} break;
-			case 0xE: { // 8xyE: set Vx = Vx SHL 1
-				byte msb = (regs[y] & 0x80) >> 7;
-				regs[x] = regs[y];
-				regs[x] <<= 1;
-				regs[0xF] = msb;
-			} break;
-			}
-		} break;
-
-		case 0x9000: { // 9xy0: skip next insruction if Vx != Vy
-			if ((regs[(instruction & 0x0F00) >> 8]) != (regs[(instruction & 0x00F0) >> 4])) pc += 2;
-		} break;
-
-		case 0xA000: { // Annn: set i = nnn
-			iReg = instruction & 0x0FFF;
-		} break;
-
-		case 0xB000: { // Bnnn: jump to location nnn + V0
-			pc = (instruction & 0x0FFF) + regs[0];
-		} break;
-
-		case 0xC000: { // Cxkk: set Vx = random byte AND kk
-			std::mt19937 rng(static_cast<uint32_t>(std::chrono::high_resolution_clock::now().time_since_epoch().count()));
-			std::uniform_int_distribution<int> dist(0, 255);
-			regs[(instruction & 0x0F00) >> 8] = dist(rng) & (instruction & 0x00FF);
-		} break;
-
-		case 0xD000: { // Dxyn: display n-byte sprite starting at memory location I at (Vx, Vy), set VF = collision.
-			byte x = regs[(instruction & 0x0F00) >> 8];
-			byte y = regs[(instruction & 0x00F0) >> 4];
-			byte n = instruction & 0x000F;
-			regs[0xF] = 0;
-
-			for (int row = 0; row < n; row++) {
-				if ((y % HEIGHT) + row >= HEIGHT) break;
-				byte spriteByte = mem[iReg + row];
-				for (int col = 0; col < 8; col++) {
-					if ((x % WIDTH) + col >= WIDTH) break;
-					byte pixel = (spriteByte >> (7 - col)) & 0x1;
-					byte screenX = (x % WIDTH) + col;
-					byte screenY = (y % HEIGHT) + row;
-					if (pixel == 1) {
-						if (screen[screenY][screenX] == 1) regs[0xF] = 1;
-						screen[screenY][screenX] ^= 1;
-					}
-				}
-			}
+	std::replace(romPath.begin(), romPath.end(), '\\', '/');
+	if (options.sampleInterval == 0 && (!options.foldedPath.empty() || !options.pprofPath.empty())) options.sampleInterval = 100;
+}
 
-		} break;
-
-		case 0xE000: { // Ex**
-			byte x = (instruction & 0x0F00) >> 8;
-			switch (instruction & 0x00FF) {
-			case 0x9E: // Ex9E: skip next instruction if key with the value of Vx is pressed
-				if (input[regs[x]]) pc += 2;
-				break;
-			case 0xA1: // ExA1: skip next instruction if key with the value of Vx is not pressed
-				if (!input[regs[x]]) pc += 2;
-				break;
-			}
-		} break;
-
-		case 0xF000: { // Fx**
-			byte x = (instruction & 0x0F00) >> 8;
-			switch (instruction & 0x00FF) {
-			case 0x07: // Fx07: set Vx = delay timer value
-				regs[x] = delayReg;
-				break;
-			case 0x0A:  // Fx0A: wait for a key press, store the value of the key in Vx
-				tempReg = x;
-				c8keState = HALT;
-				break;
-			case 0x15: // Fx15: set delay timer = Vx
-				delayReg = regs[x];
-				break;
-			case 0x18: // Fx18: set sound timer = Vx
-				soundReg = regs[x];
-				break;
-			case 0x1E: // Fx1E: set i = i + Vx
-				iReg += regs[x];
-				break;
-			case 0x29: // Fx29: set i = location of sprite for digit Vx
-				iReg = SPRITE_ADDRESS + (regs[(instruction & 0x0F00) >> 8] * 5);
-				break;
-			case 0x33: { // Fx33: store BCD representation of Vx in memory locations i, i+1, and i+2
-				byte number = regs[(instruction & 0x0F00) >> 8];
-				mem[iReg] = number / 100;
-				mem[iReg + 1] = (number / 10) % 10;
-				mem[iReg + 2] = number % 10;
-			} break;
-			case 0x55: { // Fx55: store registers V0 through Vx in memory starting at location i
-				byte x = (instruction & 0x0F00) >> 8;
-				for (int i = 0; i <= x; i++) { mem[iReg] = regs[i]; iReg++; }
-			} break;
-			case 0x65: { // Fx65: read registers V0 through Vx from memory starting at location i
-				byte x = (instruction & 0x0F00) >> 8;
-				for (int i = 0; i <= x; i++) { regs[i] = mem[iReg]; iReg++; }
-			} break;
-			}
-		} break;
-		}
+SDL_Keycode findSDLKeycode(byte chip8Key) {
+	for (const auto& [keycode, val] : keymap) {
+		if (val == chip8Key)
+			return keycode;
 	}
-
-};
+	return SDLK_UNKNOWN;
+}
 
 
 
@@ -367,18 +208,27 @@ void init() {
 	renderer = SDL_CreateRenderer(window, nullptr);
 	if (renderer == nullptr) { SDL_Log("SDL could not initialize renderer. SDL error: %s\n", SDL_GetError()); exit(1); }
 
-	// main texture
-	texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, WIDTH, HEIGHT);
+	// main texture, sized for megachip. the bitplane screens only fill and show the top left of it
+	texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, MEGA_WIDTH, MEGA_HEIGHT);
 	if (texture == nullptr) { SDL_Log("SDL could not initialize main texture: %s", SDL_GetError()); exit(1); }
 	SDL_SetTextureScaleMode(texture, SDL_SCALEMODE_NEAREST);
 
+	// memory heatmap texture, rewritten once per frame while the heatmap is open
+	heatTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, HEATMAP_WIDTH, MAX_MEM / HEATMAP_WIDTH);
+	if (heatTexture == nullptr) { SDL_Log("SDL could not initialize heatmap texture: %s", SDL_GetError()); exit(1); }
+	SDL_SetTextureScaleMode(heatTexture, SDL_SCALEMODE_NEAREST);
+
 	// emulator icon
 	icon = IMG_Load("res/cake.ico");
 	if (icon == nullptr) { SDL_Log("SDL could not load icon: %s", SDL_GetError()); exit(1); }
 	SDL_SetWindowIcon(window, icon);
 
-	// audio
-	stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, nullptr, nullptr);
+	// audio at the device's own rate so SDL never resamples the beep, the device
+	// pulls samples from the beeper on its own thread
+	SDL_AudioSpec device;
+	if (SDL_GetAudioDeviceFormat(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &device, nullptr)) spec.freq = device.freq;
+	beeper.open(spec.freq);
+	stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, Beeper::callback, &beeper);
 	if (stream == nullptr) { SDL_Log("SDL could not initialize audio stream: %s", SDL_GetError()); exit(1); }
 	SDL_ResumeAudioStreamDevice(stream);
 
@@ -408,24 +258,11 @@ void init() {
 	ImGui_ImplSDLRenderer3_Init(renderer);
 }
 
-void beep(bool beep) {
-	if (!beep) { SDL_ClearAudioStream(stream); return; }
-
-	const int total = SDL_min(customAudio.beepAmount / sizeof(float), 128); // how many float samples to generate (100 bytes worth, capped at 128 samples)
-	float samples[128];  // Array to hold generated audio samples
-
-	for (int i = 0; i < total; i++) {
-		float gain = (i < 32) ? (float)i / 32.0f : 1.0f; // volume gradually increases over the first 32 samples
-		float phase = current_sine_sample++ * customAudio.beepPhase / 8000.0f; // calculate the current phase of the sine wave (2200 Hz tone, 8000 Hz sample rate)
-		samples[i] = SDL_sinf(phase * 2.0f * SDL_PI_F) * gain; // generate sine wave sample and apply the gain
-	}
-
-	current_sine_sample %= 8000; // prevent the sine sample index from growing too large over time
-	SDL_PutAudioStreamData(stream, samples, total * sizeof(float)); // queue the generated samples to the audio stream
-}
-
 void events(c8ke& emu) {
+	ScopedZone zone("events");
+	bool polled = false;
 	while (SDL_PollEvent(&e)) {
+		polled = true;
 
 		ImGui_ImplSDL3_ProcessEvent(&e);
 
@@ -437,6 +274,7 @@ void events(c8ke& emu) {
 
 		// handle pausing
 		if (e.type == SDL_EVENT_KEY_DOWN && e.key.key == SDLK_P) {
+			if (c8keState == BREAK) breakpoints.resume();
 			c8keState = (c8keState == RUNNING) ? PAUSED : RUNNING;
 			return;
 		}
@@ -446,20 +284,427 @@ void events(c8ke& emu) {
 			auto key = keymap.find(e.key.key);
 			if (key != keymap.end()) {
 				bool pressed = (e.type == SDL_EVENT_KEY_DOWN);
-				input[key->second] = pressed;
+				emu.press(key->second, pressed);
+				history.press(key->second, pressed);
+
+				if (c8keState == HALT && !emu.waiting) c8keState = RUNNING;
+			}
+		}
+	}
+
+	if (!polled) zone.discard();
+}
+
+// runs one instruction, through the instrumented core only while a debug tool needs it.
+// true when a watchpoint fired
+bool step(c8ke& emu) {
+	DebugProbe probe;
+	if (profiling) probe.profiler = &profiler;
+	if (showHeatmap) probe.heatmap = &heatmap;
+	if (tracer.active()) probe.trace = &tracer;
+	if (breakpoints.any()) probe.breakpoints = &breakpoints;
+
+	history.beforeCycle(emu);
+	if (probe.any()) emu.cycle(probe); // the probe is a separate instantiation, plain cycle() stays untouched
+	else emu.cycle();
+	history.afterCycle();
+
+	if (emu.waiting) c8keState = HALT;
+	if (!probe.breakpoints || !breakpoints.takeTrigger()) return false;
+	c8keState = BREAK; // watchpoints stop after the access
+	return true;
+}
+
+// runs whatever the gdb client asked for, on this thread so the machine is never shared
+void serveGdb(c8ke& emu) {
+	bool stopped = c8keState == BREAK || c8keState == INIT; // nothing to run without a rom
+	int action = gdb.service(emu, breakpoints, stopped);
+	if (action == GdbServer::NONE) return;
+
+	if (action & GdbServer::MODIFIED) {
+		breakpoints.sync(emu);
+		history.reset(emu); // replaying would undo the edit
+	}
+	if ((action & GdbServer::HALT) && !stopped) {
+		c8keState = BREAK;
+		std::snprintf(breakpoints.reason, sizeof(breakpoints.reason), "stopped by gdb at 0x%03X", emu.pc);
+	}
+	if ((action & GdbServer::STEP) && c8keState == BREAK) {
+		breakpoints.resume();
+		if (!step(emu)) std::snprintf(breakpoints.reason, sizeof(breakpoints.reason), "gdb stepped to 0x%03X", emu.pc);
+		if (c8keState != HALT) c8keState = BREAK;
+	}
+	if ((action & GdbServer::RESUME) && c8keState == BREAK) {
+		breakpoints.resume();
+		c8keState = DELAYED;
+	}
+}
+
+// orders table rows by the column the user clicked, value(row, column) gives the sort key
+static void sortRows(std::vector<int>& rows, const std::function<uint64_t(int, int)>& value) {
+	ImGuiTableSortSpecs* specs = ImGui::TableGetSortSpecs();
+	if (specs == nullptr || specs->SpecsCount == 0) return;
+
+	int column = specs->Specs[0].ColumnIndex;
+	bool ascending = specs->Specs[0].SortDirection == ImGuiSortDirection_Ascending;
+	std::stable_sort(rows.begin(), rows.end(), [&](int a, int b) {
+		uint64_t va = value(a, column), vb = value(b, column);
+		return ascending ? va < vb : va > vb;
+	});
+}
+
+void drawProfiler(c8ke& emu) {
+	const ImGuiTableFlags tableFlags = ImGuiTableFlags_Sortable | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_SizingStretchProp;
+	const double total = profiler.cycles ? (double)profiler.cycles : 1.0;
+	std::vector<int> rows;
+
+	ImGui::TextColored(customColors.dbgColor1, "Cycles");
+	ImGui::SameLine();
+	ImGui::TextColored(customColors.dbgColor2, "%llu", (unsigned long long)profiler.cycles);
+	ImGui::SameLine();
+	if (ImGui::SmallButton("Reset")) profiler.reset();
+	ImGui::SameLine();
+	if (ImGui::SmallButton("Export CSV")) {
+		char const* filterPatterns[1] = { "*.csv" };
+		char* saveFileName = tinyfd_saveFileDialog("Save profile", "profile.csv", 1, filterPatterns, "CSV File");
+		if (saveFileName && !profiler.writeCsv(saveFileName)) SDL_Log("c8ke could not write profile: %s", saveFileName);
+		if (c8keState == RUNNING) c8keState = DELAYED; // don't catch up on the time spent in the dialog
+	}
+
+	if (!ImGui::BeginTabBar("##profilerTabs")) return;
+
+	if (ImGui::BeginTabItem("Opcodes")) {
+		if (ImGui::BeginTable("##opcodes", 3, tableFlags)) {
+			ImGui::TableSetupScrollFreeze(0, 1);
+			ImGui::TableSetupColumn("Opcode", ImGuiTableColumnFlags_DefaultSort);
+			ImGui::TableSetupColumn("Count", ImGuiTableColumnFlags_PreferSortDescending);
+			ImGui::TableSetupColumn("%", ImGuiTableColumnFlags_PreferSortDescending);
+			ImGui::TableHeadersRow();
+
+			for (int i = 0; i < OPCODE_CLASSES; i++) if (profiler.opcodeCounts[i]) rows.push_back(i);
+			sortRows(rows, [](int row, int column) { return column == 0 ? (uint64_t)row : profiler.opcodeCounts[row]; });
+
+			for (int row : rows) {
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn(); ImGui::TextColored(customColors.dbgColor1, "%s", opcodeNames[row]);
+				ImGui::TableNextColumn(); ImGui::TextColored(customColors.dbgColor2, "%llu", (unsigned long long)profiler.opcodeCounts[row]);
+				ImGui::TableNextColumn(); ImGui::TextColored(customColors.dbgColor2, "%.2f", 100.0 * profiler.opcodeCounts[row] / total);
+			}
+			ImGui::EndTable();
+		}
+		ImGui::EndTabItem();
+	}
+
+	if (ImGui::BeginTabItem("Hot PCs")) {
+		if (ImGui::BeginTable("##pcs", 4, tableFlags)) {
+			ImGui::TableSetupScrollFreeze(0, 1);
+			ImGui::TableSetupColumn("Address");
+			ImGui::TableSetupColumn("Instruction", ImGuiTableColumnFlags_NoSort);
+			ImGui::TableSetupColumn("Count", ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending);
+			ImGui::TableSetupColumn("%", ImGuiTableColumnFlags_PreferSortDescending);
+			ImGui::TableHeadersRow();
+
+			for (int pc = 0; pc < MAX_MEM; pc++) if (profiler.pcCounts[pc]) rows.push_back(pc);
+			sortRows(rows, [](int row, int column) { return column == 0 ? (uint64_t)row : profiler.pcCounts[row]; });
+
+			ImGuiListClipper clipper;
+			clipper.Begin((int)rows.size());
+			while (clipper.Step()) {
+				for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+					int pc = rows[i];
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn(); ImGui::TextColored(customColors.dbgColor1, "0x%04X", pc);
+					ImGui::TableNextColumn(); ImGui::TextColored(customColors.dbgColor2, "%02X%02X", emu.mem[pc], emu.mem[pc + 1]);
+					ImGui::TableNextColumn(); ImGui::TextColored(customColors.dbgColor2, "%llu", (unsigned long long)profiler.pcCounts[pc]);
+					ImGui::TableNextColumn(); ImGui::TextColored(customColors.dbgColor2, "%.2f", 100.0 * profiler.pcCounts[pc] / total);
+				}
+			}
+			ImGui::EndTable();
+		}
+		ImGui::EndTabItem();
+	}
 
-				if (c8keState == HALT && !pressed) {
-					emu.regs[tempReg] = key->second;
-					c8keState = RUNNING;
+	if (ImGui::BeginTabItem("Subroutines")) {
+		if (ImGui::BeginTable("##routines", 5, tableFlags)) {
+			ImGui::TableSetupScrollFreeze(0, 1);
+			ImGui::TableSetupColumn("Entry");
+			ImGui::TableSetupColumn("Calls", ImGuiTableColumnFlags_PreferSortDescending);
+			ImGui::TableSetupColumn("Self", ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending);
+			ImGui::TableSetupColumn("Total", ImGuiTableColumnFlags_PreferSortDescending);
+			ImGui::TableSetupColumn("Self %", ImGuiTableColumnFlags_PreferSortDescending);
+			ImGui::TableHeadersRow();
+
+			for (int entry = 0; entry < MAX_MEM; entry++) {
+				if (profiler.routines[entry].calls || profiler.routines[entry].selfCycles) rows.push_back(entry);
+			}
+			sortRows(rows, [](int row, int column) {
+				const Profiler::Routine& r = profiler.routines[row];
+				switch (column) {
+				case 0: return (uint64_t)row;
+				case 1: return r.calls;
+				case 3: return profiler.totalCycles((word)row);
+				default: return r.selfCycles;
 				}
+			});
+
+			for (int entry : rows) {
+				const Profiler::Routine& r = profiler.routines[entry];
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn(); ImGui::TextColored(customColors.dbgColor1, entry == START_ADDRESS ? "0x%04X main" : "0x%04X", entry);
+				ImGui::TableNextColumn(); ImGui::TextColored(customColors.dbgColor2, "%llu", (unsigned long long)r.calls);
+				ImGui::TableNextColumn(); ImGui::TextColored(customColors.dbgColor2, "%llu", (unsigned long long)r.selfCycles);
+				ImGui::TableNextColumn(); ImGui::TextColored(customColors.dbgColor2, "%llu", (unsigned long long)profiler.totalCycles((word)entry));
+				ImGui::TableNextColumn(); ImGui::TextColored(customColors.dbgColor2, "%.2f", 100.0 * r.selfCycles / total);
 			}
+			ImGui::EndTable();
 		}
+		ImGui::EndTabItem();
+	}
+
+	ImGui::EndTabBar();
+}
+
+// bytes the heatmap shows, the first 4KB or up to the end of a bigger xo-chip rom
+int heatmapSize(const c8ke& emu) {
+	int end = std::min(emu.memorySize(), std::max(0x1000, START_ADDRESS + emu.romSize));
+	return (end + HEATMAP_WIDTH - 1) / HEATMAP_WIDTH * HEATMAP_WIDTH;
+}
+
+void drawHeatmap(c8ke& emu) {
+	const float zoom = 4.0f;
+
+	ImGui::TextColored(ImVec4(1, 0.3f, 0.3f, 1), "write");
+	ImGui::SameLine();
+	ImGui::TextColored(ImVec4(0.3f, 1, 0.3f, 1), "execute");
+	ImGui::SameLine();
+	ImGui::TextColored(ImVec4(0.4f, 0.4f, 1, 1), "read");
+	ImGui::SameLine();
+	if (ImGui::SmallButton("Reset")) heatmap.reset();
+	ImGui::SameLine();
+	if (ImGui::SmallButton("Export Coverage")) {
+		char const* filterPatterns[1] = { "*.txt" };
+		char* saveFileName = tinyfd_saveFileDialog("Save coverage", "coverage.txt", 1, filterPatterns, "Text File");
+		if (saveFileName && !heatmap.writeCoverage(saveFileName, emu.romSize)) SDL_Log("c8ke could not write coverage: %s", saveFileName);
+		if (c8keState == RUNNING) c8keState = DELAYED;
 	}
 
+	// the shown memory is one image, rows of HEATMAP_WIDTH bytes
+	int rows = heatmapSize(emu) / HEATMAP_WIDTH;
+	ImVec2 origin = ImGui::GetCursorScreenPos();
+	ImGui::Image((ImTextureID)heatTexture, ImVec2(heatTexture->w * zoom, rows * zoom), ImVec2(0, 0), ImVec2(1, (float)rows / heatTexture->h));
+	if (ImGui::IsItemHovered()) {
+		ImVec2 mouse = ImGui::GetMousePos();
+		int x = SDL_clamp((int)((mouse.x - origin.x) / zoom), 0, HEATMAP_WIDTH - 1);
+		int y = SDL_clamp((int)((mouse.y - origin.y) / zoom), 0, rows - 1);
+		int address = y * HEATMAP_WIDTH + x;
+		ImGui::SetTooltip("0x%04X = %02X\nexecuted %llu\nread %llu\nwritten %llu", address, emu.mem[address],
+			(unsigned long long)heatmap.counts[MemoryHeatmap::EXECUTE][address],
+			(unsigned long long)heatmap.counts[MemoryHeatmap::READ][address],
+			(unsigned long long)heatmap.counts[MemoryHeatmap::WRITE][address]);
+	}
+}
+
+void drawBreakpoints(c8ke& emu) {
+	static char addressText[5] = "200";
+	static char conditionText[96] = "";
+	static std::string conditionError;
+	static int kind = 0;
+	const char* kinds = "exec\0read\0write\0read/write\0";
+
+	// run control
+	if (c8keState == BREAK) {
+		ImGui::TextColored(customColors.dbgColor1, "Stopped");
+		ImGui::SameLine();
+		ImGui::TextColored(customColors.dbgColor2, "%s", breakpoints.reason);
+		if (ImGui::SmallButton("Continue")) {
+			breakpoints.resume();
+			c8keState = DELAYED; // don't catch up on the time spent stopped
+		}
+		ImGui::SameLine();
+		if (ImGui::SmallButton("Step")) {
+			breakpoints.resume();
+			if (!step(emu)) std::snprintf(breakpoints.reason, sizeof(breakpoints.reason), "stepped to 0x%03X", emu.pc);
+			if (c8keState != HALT) c8keState = BREAK;
+		}
+		ImGui::SameLine();
+		if (ImGui::SmallButton("Step Back")) {
+			if (history.stepBack(emu)) std::snprintf(breakpoints.reason, sizeof(breakpoints.reason), "stepped back to 0x%03X", emu.pc);
+			else std::snprintf(breakpoints.reason, sizeof(breakpoints.reason), "start of history");
+			breakpoints.sync(emu);
+		}
+		ImGui::SameLine();
+		if (ImGui::SmallButton("Reverse Continue")) {
+			if (!history.reverseContinue(emu, breakpoints)) std::snprintf(breakpoints.reason, sizeof(breakpoints.reason), "start of history");
+			breakpoints.sync(emu);
+		}
+	} else {
+		ImGui::TextColored(customColors.dbgColor1, "Running");
+		ImGui::SameLine();
+		if (ImGui::SmallButton("Break") && c8keState == RUNNING) {
+			c8keState = BREAK;
+			std::snprintf(breakpoints.reason, sizeof(breakpoints.reason), "paused at 0x%03X", emu.pc);
+		}
+	}
+	ImGui::TextColored(customColors.dbgColor1, "History");
+	ImGui::SameLine();
+	ImGui::TextColored(customColors.dbgColor2, "%llu cycles, %zu keyframes every %llu", (unsigned long long)(history.cycles() - history.oldest()),
+		history.keyframeCount(), (unsigned long long)history.keyframeInterval());
+	ImGui::Separator();
+
+	// new breakpoint
+	ImGui::SetNextItemWidth(50);
+	ImGui::InputText("##address", addressText, sizeof(addressText), ImGuiInputTextFlags_CharsHexadecimal);
+	ImGui::SameLine();
+	ImGui::SetNextItemWidth(100);
+	ImGui::Combo("##kind", &kind, kinds);
+	ImGui::SameLine();
+	if (ImGui::SmallButton("Add") && addressText[0]) {
+		word address = (word)std::strtoul(addressText, nullptr, 16);
+		conditionError.clear();
+		if (kind == 0) breakpoints.setCondition(address, conditionText, conditionError);
+		if (kind == 1 || kind == 3) breakpoints.set(Breakpoints::READ, address, true);
+		if (kind == 2 || kind == 3) breakpoints.set(Breakpoints::WRITE, address, true);
+	}
+	ImGui::SameLine();
+	if (ImGui::SmallButton("Clear")) breakpoints.clear();
+	if (kind == 0) {
+		ImGui::SetNextItemWidth(-1);
+		ImGui::InputTextWithHint("##condition", "condition, e.g. V3 == 0x10 && I > 0x300", conditionText, sizeof(conditionText));
+		if (!conditionError.empty()) ImGui::TextColored(ImVec4(1, 0.3f, 0.3f, 1), "%s", conditionError.c_str());
+	}
+
+	// register watches
+	ImGui::TextColored(customColors.dbgColor1, "Watch");
+	for (int i = 0; i <= Breakpoints::I_REG; i++) {
+		char label[4];
+		std::snprintf(label, sizeof(label), i == Breakpoints::I_REG ? "I" : "V%X", i);
+		bool on = (breakpoints.watched >> i) & 1;
+		if (i % 8 != 0) ImGui::SameLine();
+		if (ImGui::Checkbox(label, &on)) breakpoints.watchRegister(i, on, emu);
+	}
+	ImGui::Separator();
+
+	// current breakpoints, one row per address
+	for (int address = 0; address < MAX_MEM; address++) {
+		bool exec = breakpoints.test(Breakpoints::EXEC, address);
+		bool read = breakpoints.test(Breakpoints::READ, address);
+		bool write = breakpoints.test(Breakpoints::WRITE, address);
+		if (!exec && !read && !write) continue;
+
+		ImGui::PushID(address);
+		if (ImGui::SmallButton("x")) {
+			for (int k = 0; k < Breakpoints::KINDS; k++) breakpoints.set((Breakpoints::Kind)k, address, false);
+		}
+		ImGui::PopID();
+		ImGui::SameLine();
+		ImGui::TextColored(customColors.dbgColor2, "0x%03X", address);
+		ImGui::SameLine();
+		ImGui::TextColored(customColors.dbgColor1, "%s%s%s", exec ? "exec " : "", read ? "read " : "", write ? "write" : "");
+
+		auto conditional = breakpoints.conditions.find((word)address);
+		if (conditional != breakpoints.conditions.end()) {
+			ImGui::SameLine();
+			ImGui::TextColored(customColors.dbgColor2, "if %s (%llu hits)", conditional->second.condition.text.c_str(), (unsigned long long)conditional->second.hits);
+		}
+	}
+}
+
+void drawDisassembly(c8ke& emu) {
+	static bool follow = true;
+	static int lastPcRow = -1;
+	disassembly.update(emu);
+
+	const std::vector<Disassembly::Row>& rows = disassembly.list();
+	const ControlFlow& flow = disassembly.flow();
+	ImGui::Checkbox("Follow PC", &follow);
+	ImGui::SameLine();
+	ImGui::TextColored(customColors.dbgColor2, "%zu blocks", flow.blocks().size());
+	const ControlFlow::Block* block = flow.blockAt(emu.pc);
+	if (block) {
+		ImGui::SameLine();
+		ImGui::TextColored(customColors.dbgColor1, "pc in 0x%03X-0x%03X", block->start, block->end - 1);
+	}
+	ImGui::Separator();
+
+	ImGui::BeginChild("##disassembly");
+	float lineHeight = ImGui::GetTextLineHeightWithSpacing();
+	int pcRow = disassembly.rowOf(emu.pc);
+	if (follow && pcRow >= 0 && pcRow != lastPcRow) {
+		// only scroll once the pc leaves the visible part
+		float y = pcRow * lineHeight;
+		if (y < ImGui::GetScrollY() || y > ImGui::GetScrollY() + ImGui::GetWindowHeight() - lineHeight) ImGui::SetScrollY(y - ImGui::GetWindowHeight() / 2);
+	}
+	lastPcRow = pcRow;
+
+	// rows off screen are never formatted
+	ImGuiListClipper clipper;
+	clipper.Begin((int)rows.size(), lineHeight);
+	while (clipper.Step()) {
+		for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+			const Disassembly::Row& row = rows[i];
+			if (row.kind == Disassembly::LABEL) {
+				ImGui::TextColored(customColors.dbgColor1, "%s", disassembly.text(i));
+				continue;
+			}
+
+			bool code = row.kind == Disassembly::INSTRUCTION;
+			bool breakpoint = code && breakpoints.test(Breakpoints::EXEC, row.address);
+			ImVec4 color = (i == pcRow) ? customColors.dbgColor1 : (code ? customColors.dbgColor2 : customColors.dbgColor3);
+			ImGui::TextColored(color, "%c%c 0x%03X  %s", breakpoint ? '*' : ' ', (i == pcRow) ? '>' : ' ', row.address, disassembly.text(i));
+			if (code && ImGui::IsItemClicked()) breakpoints.set(Breakpoints::EXEC, row.address, !breakpoint); // click toggles a breakpoint
+		}
+	}
+	ImGui::EndChild();
+}
+
+// one metric of the overlay: latest value, window stats and the window as a histogram
+template <int N>
+static void drawPerfRow(const char* label, const RollingStats<N>& stats, const char* format) {
+	char value[32];
+	ImGui::TableNextColumn(); ImGui::TextColored(customColors.dbgColor1, "%s", label);
+	const float columns[4] = { stats.last(), stats.min(), stats.avg(), stats.percentile(0.99f) };
+	for (float column : columns) {
+		std::snprintf(value, sizeof(value), format, column);
+		ImGui::TableNextColumn(); ImGui::TextColored(customColors.dbgColor2, "%s", value);
+	}
+	ImGui::TableNextColumn();
+	ImGui::PushID(label);
+	ImGui::PlotHistogram("##history", stats.data(), stats.size(), stats.offset(), nullptr, 0.0f, stats.max() * 1.1f + 0.001f, ImVec2(160, 18));
+	ImGui::PopID();
+}
+
+void drawPerf(const c8ke& emu) {
+	ImGui::TextColored(customColors.dbgColor1, "Target");
+	ImGui::SameLine();
+	ImGui::TextColored(customColors.dbgColor2, "%s%s, %d ips, %d fps, %.1f ms", platformNames[emu.platform], emu.timed() ? " (VIP timing, at most)" : "", emu.clock(), FPS, TIME_PER_REFRESH / 1e6);
+	ImGui::TextColored(customColors.dbgColor1, "Catch-up bursts");
+	ImGui::SameLine();
+	ImGui::TextColored(customColors.dbgColor2, "%llu (largest %llu cycles)", (unsigned long long)perf.catchUps, (unsigned long long)perf.largestBurst);
+	ImGui::TextColored(customColors.dbgColor1, "Audio");
+	ImGui::SameLine();
+	ImGui::TextColored(customColors.dbgColor2, "%s, speed %+.2f%%, %llu underruns, %llu overruns", customAudio.sync ? "sync" : "free", customAudio.sync ? (beeper.speed() - 1.0) * 100.0 : 0.0,
+		(unsigned long long)beeper.underruns(), (unsigned long long)beeper.overruns());
+
+	if (!ImGui::BeginTable("##perf", 6, ImGuiTableFlags_SizingFixedFit)) return;
+	ImGui::TableSetupColumn("");
+	ImGui::TableSetupColumn("now");
+	ImGui::TableSetupColumn("min");
+	ImGui::TableSetupColumn("avg");
+	ImGui::TableSetupColumn("p99");
+	ImGui::TableSetupColumn("history");
+	ImGui::TableHeadersRow();
+	drawPerfRow("Frame ms", perf.frameMs, "%.2f");
+	drawPerfRow("Jitter ms", perf.jitterMs, "%.2f");
+	drawPerfRow("Instr/s", perf.instructionsPerSecond, "%.0f");
+	drawPerfRow("Instr/vblank", perf.cyclesPerFrame, "%.0f");
+	drawPerfRow("Burst", perf.burstCycles, "%.0f");
+	drawPerfRow("Audio lag ms", perf.audioMs, "%.1f");
+	ImGui::EndTable();
 }
 
 void draw(c8ke& emu) {
 	/***** ImGui *****/
+	ScopedZone build("imgui build");
 	ImGui_ImplSDLRenderer3_NewFrame();
 	ImGui_ImplSDL3_NewFrame();
 	ImGui::NewFrame();
@@ -472,8 +717,8 @@ void draw(c8ke& emu) {
 	if (ImGui::BeginMainMenuBar()) {
 		if (ImGui::BeginMenu("File")) {
 			if (ImGui::MenuItem("Open", nullptr)) {
-				char const* filterPatterns[1] = { "*.ch8" };
-				char* openFileName = tinyfd_openFileDialog("Choose a CHIP-8 rom file to open", nullptr, 1, filterPatterns, "CH8 File", 1);
+				char const* filterPatterns[6] = { "*.ch8", "*.c8", "*.c48", "*.sc8", "*.xo8", "*.mc8" };
+				char* openFileName = tinyfd_openFileDialog("Choose a CHIP-8 rom file to open", nullptr, 6, filterPatterns, "CHIP-8 Roms", 1);
 				if (openFileName) {
 					romPath = openFileName;
 					std::replace(romPath.begin(), romPath.end(), '\\', '/');
@@ -503,6 +748,27 @@ void draw(c8ke& emu) {
 		}
 
 		if (ImGui::BeginMenu("Settings")) {
+			if (ImGui::BeginMenu("Platform")) {
+				// a different platform is a different machine, the rom starts over on it
+				Platform chosen = options.platform;
+				if (ImGui::MenuItem("Auto", nullptr, chosen == AUTO)) chosen = AUTO;
+				ImGui::Separator();
+				for (int p = 0; p < PLATFORMS; p++) {
+					if (ImGui::MenuItem(platformNames[p], nullptr, chosen == p)) chosen = (Platform)p;
+				}
+				ImGui::Separator();
+				bool vipTiming = options.vipTiming;
+				ImGui::MenuItem("COSMAC VIP timing", nullptr, &vipTiming); // chip8 only
+				if (chosen != options.platform || vipTiming != options.vipTiming) {
+					options.platform = chosen;
+					options.vipTiming = vipTiming;
+					if (!romPath.empty()) c8keState = RELOAD;
+				}
+				ImGui::EndMenu();
+			}
+
+			ImGui::Separator();
+
 			if (ImGui::BeginMenu("Colors")) {
 				if (ImGui::ColorButton("##emuFg", customColors.emuFg, COLOR_EDIT_FLAGS_COLOR_BUTTON, ImVec2(20, 20))) showFgPicker = !showFgPicker;
 				ImGui::SameLine();
@@ -599,7 +865,7 @@ void draw(c8ke& emu) {
 				ImGui::PushStyleColor(ImGuiCol_ButtonActive, IM_COL32(60, 60, 60, 255));
 				ImGui::PushStyleColor(ImGuiCol_FrameBg, IM_COL32(19, 19, 19, 255));
 				ImGui::PushStyleColor(ImGuiCol_TextSelectedBg, IM_COL32(60, 60, 60, 255));
-				ImGui::InputInt("Beep Adjustment 1", &customAudio.beepAmount);
+				ImGui::InputInt("Tone (Hz)", &customAudio.tone);
 				ImGui::PopStyleColor(5);
 				ImGui::Separator();
 
@@ -609,13 +875,39 @@ void draw(c8ke& emu) {
 				ImGui::PushStyleColor(ImGuiCol_ButtonActive, IM_COL32(60, 60, 60, 255));
 				ImGui::PushStyleColor(ImGuiCol_FrameBg, IM_COL32(19, 19, 19, 255));
 				ImGui::PushStyleColor(ImGuiCol_TextSelectedBg, IM_COL32(60, 60, 60, 255));
-				ImGui::InputInt("Beep Adjustment 2", &customAudio.beepPhase);
+				ImGui::InputInt("Volume (%)", &customAudio.volume);
 				ImGui::PopStyleColor(5);
 				ImGui::Separator();
 
+				ImGui::SetNextItemWidth(150);
+				ImGui::PushStyleColor(ImGuiCol_Button, IM_COL32(19, 19, 19, 255));
+				ImGui::PushStyleColor(ImGuiCol_ButtonHovered, IM_COL32(60, 60, 60, 255));
+				ImGui::PushStyleColor(ImGuiCol_ButtonActive, IM_COL32(60, 60, 60, 255));
+				ImGui::PushStyleColor(ImGuiCol_FrameBg, IM_COL32(19, 19, 19, 255));
+				ImGui::PushStyleColor(ImGuiCol_TextSelectedBg, IM_COL32(60, 60, 60, 255));
+				ImGui::InputInt("Attack (ms)", &customAudio.attack);
+				ImGui::PopStyleColor(5);
+				ImGui::Separator();
+
+				ImGui::SetNextItemWidth(150);
+				ImGui::PushStyleColor(ImGuiCol_Button, IM_COL32(19, 19, 19, 255));
+				ImGui::PushStyleColor(ImGuiCol_ButtonHovered, IM_COL32(60, 60, 60, 255));
+				ImGui::PushStyleColor(ImGuiCol_ButtonActive, IM_COL32(60, 60, 60, 255));
+				ImGui::PushStyleColor(ImGuiCol_FrameBg, IM_COL32(19, 19, 19, 255));
+				ImGui::PushStyleColor(ImGuiCol_TextSelectedBg, IM_COL32(60, 60, 60, 255));
+				ImGui::InputInt("Release (ms)", &customAudio.release);
+				ImGui::PopStyleColor(5);
+				ImGui::Separator();
+
+				ImGui::MenuItem("Sync to audio clock", nullptr, &customAudio.sync);
+				ImGui::Separator();
+
 				if (ImGui::MenuItem("Reset to default")) {
-					customAudio.beepAmount = DEFAULT_BEEP_AMOUNT;
-					customAudio.beepPhase = DEFAULT_BEEP_PHASE;
+					customAudio.tone = DEFAULT_BEEP_TONE;
+					customAudio.volume = DEFAULT_BEEP_VOLUME;
+					customAudio.attack = DEFAULT_BEEP_ATTACK;
+					customAudio.release = DEFAULT_BEEP_RELEASE;
+					customAudio.sync = false;
 				}
 
 				ImGui::EndMenu();
@@ -633,17 +925,60 @@ void draw(c8ke& emu) {
 			showDbgHeaderBgPicker = false;
 		}
 
+		if (ImGui::BeginMenu("Debug")) {
+			if (ImGui::MenuItem("Profiler", nullptr, &profiling) && profiling) profiler.reset();
+			ImGui::Separator();
+
+			if (!tracer.active() && ImGui::MenuItem("Start Trace...")) {
+				char const* filterPatterns[1] = { "*.c8t" };
+				char* saveFileName = tinyfd_saveFileDialog("Save trace", "trace.c8t", 1, filterPatterns, "c8ke Trace");
+				if (saveFileName && !tracer.start(saveFileName)) SDL_Log("c8ke could not write trace: %s", saveFileName);
+				if (c8keState == RUNNING) c8keState = DELAYED;
+			}
+			if (tracer.active() && ImGui::MenuItem("Stop Trace")) {
+				SDL_Log("c8ke traced %llu instructions", (unsigned long long)tracer.recorded());
+				tracer.stop();
+			}
+			ImGui::MenuItem("Performance Overlay", nullptr, &showPerf);
+			if (ImGui::MenuItem("Memory Heatmap", nullptr, &showHeatmap) && showHeatmap) heatmap.reset();
+			ImGui::MenuItem("Breakpoints", nullptr, &showBreakpoints);
+			ImGui::MenuItem("Disassembly", nullptr, &showDisassembly);
+			ImGui::Separator();
+
+			bool recording = timeline.recording();
+			if (ImGui::MenuItem("Record Timeline", nullptr, &recording)) {
+				if (recording) timeline.clear();
+				timeline.record(recording);
+			}
+			if (ImGui::MenuItem("Save Timeline...", nullptr, false, recording)) {
+				char const* filterPatterns[1] = { "*.json" };
+				char* saveFileName = tinyfd_saveFileDialog("Save timeline", "timeline.json", 1, filterPatterns, "Chrome Trace");
+				if (saveFileName && !timeline.write(saveFileName)) SDL_Log("c8ke could not write timeline: %s", saveFileName);
+				if (c8keState == RUNNING) c8keState = DELAYED;
+			}
+			ImGui::EndMenu();
+		}
+
 		ImGui::EndMainMenuBar();
 	}
 	ImGui::PopStyleColor(4);
 
+	// the audio menu or imgui.ini may have changed these, a few atomic stores
+	beeper.configure((float)customAudio.tone, SDL_clamp(customAudio.volume, 0, 100) / 100.0f, (float)SDL_max(customAudio.attack, 0), (float)SDL_max(customAudio.release, 0));
+
 	// emulator screen
 	ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0, 0));
 	ImGui::PushStyleVar(ImGuiStyleVar_WindowBorderSize, 0);
 	ImGui::SetNextWindowPos(ImVec2(0, ImGui::GetFrameHeight()));
 	ImGui::SetNextWindowSize(ImVec2(WIDTH * SCALE, HEIGHT * SCALE));
 	ImGui::Begin("CHIP-8 Screen", nullptr, emulatorScreen);
-	ImGui::Image((ImTextureID)texture, ImVec2(texture->w * SCALE, texture->h * SCALE));
+	if (emu.mega.active()) { // 4:3, centered in the 2:1 window
+		float width = HEIGHT * SCALE * MEGA_WIDTH / MEGA_HEIGHT;
+		ImGui::SetCursorPosX((WIDTH * SCALE - width) / 2);
+		ImGui::Image((ImTextureID)texture, ImVec2(width, HEIGHT * SCALE));
+	} else {
+		ImGui::Image((ImTextureID)texture, ImVec2(WIDTH * SCALE, HEIGHT * SCALE), ImVec2(0, 0), ImVec2((float)emu.width() / MEGA_WIDTH, (float)emu.height() / MEGA_HEIGHT));
+	}
 	ImVec2 chip8_screen_pos = ImGui::GetWindowPos();
 	ImVec2 chip8_screen_size = ImGui::GetWindowSize();
 	ImGui::End();
@@ -693,6 +1028,10 @@ void draw(c8ke& emu) {
 	ImGui::Begin("Main Registers", nullptr, nonscrollable);
 	ImVec4 currentColor;
 
+	ImGui::TextColored(customColors.dbgColor1, "Platform       ");
+	ImGui::SameLine();
+	ImGui::TextColored(customColors.dbgColor2, "\t%s", platformNames[emu.platform]);
+
 	ImGui::TextColored(customColors.dbgColor1, "Program Counter");
 	ImGui::SameLine();
 	currentColor = (emu.pc == 0) ? customColors.dbgColor3 : customColors.dbgColor2;
@@ -766,62 +1105,151 @@ void draw(c8ke& emu) {
 	ImGui::SetNextWindowPos(ImVec2(chip8_screen_pos.x, chip8_screen_pos.y + chip8_screen_size.y));
 	ImGui::SetNextWindowSize(ImVec2(chip8_screen_size.x, WINDOW_HEIGHT - chip8_screen_size.y - ImGui::GetFrameHeight()));
 	ImGui::Begin("Memory", nullptr, scrollable);
-	bool byte2 = false;
-
-	for (int i = 0; i < MAX_MEM; i += 16) {
-		ImGui::TextColored(customColors.dbgColor1, "0x%04X\t", i);
-		ImGui::SameLine();
 
-		for (int j = 0; j < 16; j++) {
-			unsigned char byte = emu.mem[i + j];
-			currentColor = (byte == 0) ? customColors.dbgColor3 : customColors.dbgColor2;
-			ImGui::TextColored(currentColor, "%02X", byte);
+	// 256 rows on the 4KB platforms and 4096 with 64KB, only the visible ones are drawn
+	ImGuiListClipper memoryClipper;
+	memoryClipper.Begin(emu.memorySize() / 16);
+	while (memoryClipper.Step()) {
+		for (int i = memoryClipper.DisplayStart * 16; i < memoryClipper.DisplayEnd * 16; i += 16) {
+			bool byte2 = false;
+			ImGui::TextColored(customColors.dbgColor1, "0x%04X\t", i);
 			ImGui::SameLine();
 
-			if (byte2 && j < 15) {
-				ImGui::Text(" ");
+			for (int j = 0; j < 16; j++) {
+				unsigned char byte = emu.mem[i + j];
+				currentColor = (byte == 0) ? customColors.dbgColor3 : customColors.dbgColor2;
+				ImGui::TextColored(currentColor, "%02X", byte);
 				ImGui::SameLine();
+
+				if (byte2 && j < 15) {
+					ImGui::Text(" ");
+					ImGui::SameLine();
+				}
+				byte2 = !byte2;
 			}
-			byte2 = !byte2;
-		}
 
-		ImGui::NewLine();
+			ImGui::NewLine();
+		}
 	}
 
 	ImGui::End();
 	ImGui::PopStyleColor(4);
 
+	// profiler
+	if (profiling) {
+		ImGui::PushStyleColor(ImGuiCol_Text, customColors.dbgHeaderFg);
+		ImGui::PushStyleColor(ImGuiCol_TitleBg, customColors.dbgHeaderBg);
+		ImGui::PushStyleColor(ImGuiCol_TitleBgActive, customColors.dbgHeaderBg);
+		ImGui::PushStyleColor(ImGuiCol_WindowBg, customColors.dbgBg);
+		ImGui::SetNextWindowPos(ImVec2(chip8_screen_pos.x + 40, chip8_screen_pos.y + 40), ImGuiCond_FirstUseEver);
+		ImGui::SetNextWindowSize(ImVec2(560, 420), ImGuiCond_FirstUseEver);
+		ImGui::Begin("Profiler", &profiling, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoCollapse);
+		drawProfiler(emu);
+		ImGui::End();
+		ImGui::PopStyleColor(4);
+	}
+
+	// memory heatmap
+	if (showHeatmap) {
+		ImGui::PushStyleColor(ImGuiCol_Text, customColors.dbgHeaderFg);
+		ImGui::PushStyleColor(ImGuiCol_TitleBg, customColors.dbgHeaderBg);
+		ImGui::PushStyleColor(ImGuiCol_TitleBgActive, customColors.dbgHeaderBg);
+		ImGui::PushStyleColor(ImGuiCol_WindowBg, customColors.dbgBg);
+		ImGui::SetNextWindowPos(ImVec2(chip8_screen_pos.x + 80, chip8_screen_pos.y + 60), ImGuiCond_FirstUseEver);
+		ImGui::Begin("Memory Heatmap", &showHeatmap, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_AlwaysAutoResize);
+		drawHeatmap(emu);
+		ImGui::End();
+		ImGui::PopStyleColor(4);
+	}
+
+	// breakpoints
+	if (showBreakpoints) {
+		ImGui::PushStyleColor(ImGuiCol_Text, customColors.dbgHeaderFg);
+		ImGui::PushStyleColor(ImGuiCol_TitleBg, customColors.dbgHeaderBg);
+		ImGui::PushStyleColor(ImGuiCol_TitleBgActive, customColors.dbgHeaderBg);
+		ImGui::PushStyleColor(ImGuiCol_WindowBg, customColors.dbgBg);
+		ImGui::SetNextWindowPos(ImVec2(chip8_screen_pos.x + 120, chip8_screen_pos.y + 80), ImGuiCond_FirstUseEver);
+		ImGui::SetNextWindowSize(ImVec2(360, 320), ImGuiCond_FirstUseEver);
+		ImGui::Begin("Breakpoints", &showBreakpoints, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoCollapse);
+		drawBreakpoints(emu);
+		ImGui::End();
+		ImGui::PopStyleColor(4);
+	}
+
+	// disassembly, starts out over the right side of the memory window
+	if (showDisassembly) {
+		ImGui::PushStyleColor(ImGuiCol_Text, customColors.dbgHeaderFg);
+		ImGui::PushStyleColor(ImGuiCol_TitleBg, customColors.dbgHeaderBg);
+		ImGui::PushStyleColor(ImGuiCol_TitleBgActive, customColors.dbgHeaderBg);
+		ImGui::PushStyleColor(ImGuiCol_WindowBg, customColors.dbgBg);
+		ImGui::SetNextWindowPos(ImVec2(chip8_screen_pos.x + chip8_screen_size.x - 340, chip8_screen_pos.y + chip8_screen_size.y), ImGuiCond_FirstUseEver);
+		ImGui::SetNextWindowSize(ImVec2(340, WINDOW_HEIGHT - chip8_screen_size.y - ImGui::GetFrameHeight()), ImGuiCond_FirstUseEver);
+		ImGui::Begin("Disassembly", &showDisassembly, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoCollapse);
+		drawDisassembly(emu);
+		ImGui::End();
+		ImGui::PopStyleColor(4);
+	}
+
+	// performance overlay, pinned to the top right of the emulator screen
+	if (showPerf) {
+		const ImGuiWindowFlags overlay = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav;
+		ImGui::SetNextWindowPos(ImVec2(chip8_screen_pos.x + chip8_screen_size.x - 10, chip8_screen_pos.y + 10), ImGuiCond_Always, ImVec2(1.0f, 0.0f));
+		ImGui::SetNextWindowBgAlpha(0.75f);
+		ImGui::Begin("Performance", &showPerf, overlay);
+		drawPerf(emu);
+		ImGui::End();
+	}
+
 	/***** SDL *****/
-	Uint8 fr = (Uint8)(customColors.emuFg.x * 255.0f);
-	Uint8 fg = (Uint8)(customColors.emuFg.y * 255.0f);
-	Uint8 fb = (Uint8)(customColors.emuFg.z * 255.0f);
-	Uint8 fa = (Uint8)(customColors.emuFg.w * 255.0f);
-	Uint8 br = (Uint8)(customColors.emuBg.x * 255.0f);
-	Uint8 bg = (Uint8)(customColors.emuBg.y * 255.0f);
-	Uint8 bb = (Uint8)(customColors.emuBg.z * 255.0f);
-	Uint8 ba = (Uint8)(customColors.emuBg.w * 255.0f);
-
-	// draw the emulator screen
-	SDL_SetRenderTarget(renderer, texture);
-	SDL_SetRenderDrawColor(renderer, br, bg, bb, ba);
-	SDL_RenderClear(renderer);
-	SDL_SetRenderDrawColor(renderer, fr, fg, fb, fa);
-	for (int y = 0; y < HEIGHT; y++) {
-		for (int x = 0; x < WIDTH; x++) {
-			if (screen[y][x]) {
-				SDL_FRect pixel = { (float)x, (float)y, 1, 1 }; // render 1x1 pixels
-				SDL_RenderFillRect(renderer, &pixel);
-			}
-		}
+	build.end();
+	ScopedZone upload("texture update");
+	Uint8 fg[4] = { (Uint8)(customColors.emuFg.x * 255.0f), (Uint8)(customColors.emuFg.y * 255.0f), (Uint8)(customColors.emuFg.z * 255.0f), (Uint8)(customColors.emuFg.w * 255.0f) };
+	Uint8 bg[4] = { (Uint8)(customColors.emuBg.x * 255.0f), (Uint8)(customColors.emuBg.y * 255.0f), (Uint8)(customColors.emuBg.z * 255.0f), (Uint8)(customColors.emuBg.w * 255.0f) };
+	Uint32 palette[16];
+	SDL_memcpy(&palette[0], bg, 4);
+	SDL_memcpy(&palette[1], fg, 4);
+	for (int i = 2; i < 16; i++) {
+		Uint8 rgba[4] = { XO_PALETTE[i - 2][0], XO_PALETTE[i - 2][1], XO_PALETTE[i - 2][2], 255 };
+		SDL_memcpy(&palette[i], rgba, 4);
+	}
+
+	// draw the emulator screen, only the part the current resolution uses goes up.
+	// megachip frames are already rgba, opaque so a cleared screen is black, and
+	// 05nn fades them towards black
+	if (emu.mega.active()) {
+		SDL_UpdateTexture(texture, nullptr, emu.mega.front(), MEGA_WIDTH * 4);
+		SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE);
+		SDL_SetTextureColorMod(texture, emu.screenAlpha, emu.screenAlpha, emu.screenAlpha);
+	} else {
+		static Uint32 screenPixels[HIRES_WIDTH * HIRES_HEIGHT];
+		toRgba(emu, palette, screenPixels, HIRES_WIDTH);
+		SDL_Rect area = { 0, 0, emu.width(), emu.height() };
+		SDL_UpdateTexture(texture, &area, screenPixels, HIRES_WIDTH * 4);
+		SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+		SDL_SetTextureColorMod(texture, 255, 255, 255);
+	}
+
+	// heatmap goes up as a single texture, then cools down for the next frame
+	if (showHeatmap) {
+		static byte heatPixels[MAX_MEM * 4];
+		int size = heatmapSize(emu);
+		heatmap.toRgba(heatPixels, size);
+		SDL_Rect rows = { 0, 0, HEATMAP_WIDTH, size / HEATMAP_WIDTH };
+		SDL_UpdateTexture(heatTexture, &rows, heatPixels, HEATMAP_WIDTH * 4);
+		heatmap.decay(HEATMAP_DECAY, size);
 	}
-	SDL_SetRenderTarget(renderer, nullptr);
 
 
 	/***** render and present *****/
+	upload.end();
+	ScopedZone render("render draw data");
 	ImGui::Render();
 	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
 	SDL_RenderClear(renderer);
 	ImGui_ImplSDLRenderer3_RenderDrawData(ImGui::GetDrawData(), renderer);
+	render.end();
+
+	ScopedZone present("present");
 	SDL_RenderPresent(renderer);
 }
 
@@ -835,14 +1263,23 @@ void run(c8ke& emu) {
 
 		// reset loaded rom
 		if (c8keState == RELOAD) {
-			clear();
-			emu.reset();
-			emu.loadRom(romPath);
+			emu.vipTiming = options.vipTiming;
+			emu.reset(newSeed());
+			profiler.reset();
+			heatmap.reset();
+			if (!emu.loadRom(romPath, options.platform, detectPlatform)) {
+				std::cerr << "c8ke - Error opening rom file" << std::endl;
+				exit(1);
+			}
+			breakpoints.sync(emu); // breakpoints survive a reload, register watches start over
+			history.reset(emu);
+			disassembly.reset();
 
 			c8keState = RUNNING;
 			cycleDelta = 0.0;
 			refreshDelta = 0.0;
 			last = std::chrono::high_resolution_clock::now();
+			perf.restart();
 		}
 
 		// reset timing so emulator does not over-compensate
@@ -850,21 +1287,23 @@ void run(c8ke& emu) {
 			cycleDelta = 0.0;
 			refreshDelta = 0.0;
 			last = std::chrono::high_resolution_clock::now();
+			perf.restart();
 			c8keState = RUNNING;
 		}
 
 		// completely reset the emulator, except for custom colors
 		if (c8keState == RESET) {
-			clear();
-			emu.reset();
+			emu.reset(newSeed());
 			romPath = "";
+			breakpoints.clear();
+			history.reset(emu);
+			disassembly.reset();
 
 			c8keState = INIT;
 			cycleDelta = 0.0;
 			refreshDelta = 0.0;
 			last = std::chrono::high_resolution_clock::now();
-
-			emu.instruction = 0;
+			perf.restart();
 		}
 
 		// setup for CHIP-8 halt instruction
@@ -872,36 +1311,51 @@ void run(c8ke& emu) {
 			cycleDelta = 0.0;
 			refreshDelta = 0.0;
 			last = std::chrono::high_resolution_clock::now();
+			perf.restart();
 			c8keState = HALT;
 		}
 
 		// calculate new timings
 		now = std::chrono::high_resolution_clock::now();
 		elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count();
-		cycleDelta += elapsed;
-		refreshDelta += elapsed;
+		double scaled = customAudio.sync ? elapsed * beeper.speed() : (double)elapsed; // slaved to the audio device, see audio.h
+		cycleDelta += scaled;
+		refreshDelta += scaled;
 
 		// handles events, input
 		events(emu);
+		if (gdb.active()) serveGdb(emu);
 
 		// cycle instructions
-		while (cycleDelta >= TIME_PER_CYCLE) {
-			cycleDelta -= TIME_PER_CYCLE;
-			if (c8keState == RUNNING) emu.cycle();
+		ScopedZone burst("cycles");
+		int burstCycles = 0;
+		const double timePerCycle = 1000000000.0 / emu.clock(); // each platform runs at its own speed
+		while (cycleDelta >= timePerCycle) {
+			cycleDelta -= timePerCycle;
+			if (c8keState == RUNNING) {
+				if (breakpoints.any() && breakpoints.shouldBreak(emu)) {
+					c8keState = BREAK;
+					break;
+				}
+				step(emu);
+				burstCycles++;
+			}
 		}
+		if (burstCycles == 0) burst.discard();
+		burst.end();
+		perf.burst(burstCycles);
 
 		// update screen, sound, delay
 		if (refreshDelta >= TIME_PER_REFRESH) {
 			refreshDelta -= TIME_PER_REFRESH;
+			ScopedZone frame("frame");
+			perf.frame(std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count(), beeper.lagMs());
 			draw(emu);
-
-			if (emu.delayReg > 0) emu.delayReg--;
-			if (emu.soundReg > 0) emu.soundReg--;
+			if (c8keState != BREAK) { emu.tick(); history.tick(); }
+			beeper.frame(emu, emu.soundReg > 0 && c8keState != BREAK);
+			sharedState.publish(emu);
 		}
 
-		// actual sound
-		beep(emu.soundReg > 0);
-
 		// update for next cycle
 		last = now;
 	}
@@ -909,6 +1363,9 @@ void run(c8ke& emu) {
 }
 
 void shutdown() {
+	gdb.stop();
+	if (!options.timelinePath.empty() && !timeline.write(options.timelinePath)) SDL_Log("c8ke could not write timeline: %s", options.timelinePath.c_str());
+
 	// safely shutdown ImGui
 	ImGui_ImplSDLRenderer3_Shutdown();
 	ImGui_ImplSDL3_Shutdown();
@@ -917,17 +1374,130 @@ void shutdown() {
 	// safely shutdown SDL
 	if (stream) { SDL_DestroyAudioStream(stream); stream = nullptr; }
 	if (icon) { SDL_DestroySurface(icon); icon = nullptr; }
+	if (heatTexture) { SDL_DestroyTexture(heatTexture); heatTexture = nullptr; }
 	if (texture) { SDL_DestroyTexture(texture); texture = nullptr; }
 	if (renderer) { SDL_DestroyRenderer(renderer); renderer = nullptr; }
 	if (window) { SDL_DestroyWindow(window); window = nullptr; }
 	SDL_Quit();
 }
 
+bool readImage(const std::string& path, std::vector<byte>& image) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) return false;
+	image.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return true;
+}
+
+// the rom on the low level vip, alone to see the original run or in lockstep
+// with the core to find where the two disagree
+int runVip(c8ke& emu, const std::vector<uint16_t>& inputs) {
+	std::vector<byte> monitor, interpreter;
+	if (!readImage(options.vipRomPath, monitor) || !readImage(options.vipInterpreterPath, interpreter)) {
+		std::cerr << "c8ke - The VIP needs --vip-rom and --vip-interpreter images" << std::endl;
+		return 1;
+	}
+
+	std::vector<byte> program(emu.romSize);
+	for (word i = 0; i < emu.romSize; i++) program[i] = emu.mem[START_ADDRESS + i];
+	Vip vip;
+	if (!vip.boot(monitor, interpreter, program.data(), program.size())) {
+		std::cerr << "c8ke - The VIP monitor must be 512 bytes and the interpreter fit below 0x200" << std::endl;
+		return 1;
+	}
+	vip.inputs = &inputs;
+	vip.keys = inputs.empty() ? 0 : inputs[0];
+
+	char line[160];
+	if (options.oracle) {
+		emu.vipTiming = false; // the vip sets the pace
+		Divergence d = diffAgainstVip(vip, emu, options.frames);
+		if (d.found) {
+			std::snprintf(line, sizeof(line), "c8ke - Core and VIP diverge after %llu instructions at %03X (%04X): %s",
+				(unsigned long long)d.instructions, d.pc, d.instruction, d.detail);
+			std::cout << line << std::endl;
+			return 2;
+		}
+		std::snprintf(line, sizeof(line), "c8ke - Core matches the VIP for %llu instructions over %llu frames",
+			(unsigned long long)d.instructions, (unsigned long long)vip.frames);
+		std::cout << line << std::endl;
+		return 0;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	while (vip.frames < (uint64_t)options.frames) vip.frame();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::snprintf(line, sizeof(line), "c8ke - Ran %lld frames on the VIP, %llu 1802 instructions, %.0fx real time",
+		options.frames, (unsigned long long)vip.cpu.instructions, vip.cpu.cycles / VIP_CYCLES_PER_SECOND / std::max(seconds, 1e-9));
+	std::cout << line << std::endl;
+	return 0;
+}
+
+// batch mode for long playthroughs, no SDL at all
+int runHeadless(c8ke& emu) {
+	bool vip = options.lle || options.oracle; // the vip only runs chip8
+	if (romPath.empty()) { std::cerr << "c8ke - Headless mode needs a rom file" << std::endl; return 1; }
+	if (!emu.loadRom(romPath, vip ? CHIP8 : options.platform, detectPlatform)) { std::cerr << "c8ke - Error opening rom file" << std::endl; return 1; }
+
+	std::vector<uint16_t> inputs;
+	if (!options.inputsPath.empty()) {
+		std::ifstream file(options.inputsPath);
+		if (!file.is_open()) { std::cerr << "c8ke - Error opening inputs file" << std::endl; return 1; }
+		std::string line;
+		for (int number = 1; std::getline(file, line); number++) {
+			while (!line.empty() && std::isspace((unsigned char)line.back())) line.pop_back(); // crlf files
+			if (line.empty()) continue;
+			char* end = nullptr;
+			unsigned long keys = std::strtoul(line.c_str(), &end, 16);
+			if (end == line.c_str() || *end != '\0' || keys > 0xFFFF) {
+				std::cerr << "c8ke - Bad key mask in " << options.inputsPath << " line " << number << std::endl;
+				return 1;
+			}
+			inputs.push_back((uint16_t)keys);
+		}
+	}
+	if (vip) return runVip(emu, inputs);
+
+	Sampler sampler(emu, options.sampleInterval);
+	DebugProbe probe;
+	if (options.sampleInterval) probe.sampler = &sampler;
+	if (!options.coveragePath.empty()) probe.heatmap = &heatmap;
+	if (!options.tracePath.empty()) {
+		if (!tracer.start(options.tracePath)) { std::cerr << "c8ke - Error opening trace file" << std::endl; return 1; }
+		probe.trace = &tracer;
+	}
+
+	for (long long frame = 0; frame < options.frames; frame++) {
+		uint16_t keys = (frame < (long long)inputs.size()) ? inputs[frame] : 0;
+		if (probe.any()) emu.frame(keys, probe);
+		else emu.frame(keys);
+		sharedState.publish(emu);
+	}
+	tracer.stop(); // drains the ring before the summary
+
+	if (!options.foldedPath.empty() && !sampler.writeFolded(options.foldedPath)) { std::cerr << "c8ke - Error writing folded stacks" << std::endl; return 1; }
+	if (!options.pprofPath.empty() && !sampler.writePprof(options.pprofPath)) { std::cerr << "c8ke - Error writing pprof profile" << std::endl; return 1; }
+	if (!options.coveragePath.empty() && !heatmap.writeCoverage(options.coveragePath, emu.romSize)) { std::cerr << "c8ke - Error writing coverage" << std::endl; return 1; }
+
+	std::cout << "c8ke - Ran " << options.frames << " frames";
+	if (options.sampleInterval) std::cout << ", " << sampler.samples() << " samples (" << sampler.truncated() << " truncated)";
+	if (probe.trace) std::cout << ", " << tracer.recorded() << " instructions traced";
+	std::cout << std::endl;
+	return 0;
+}
+
 int main(int argc, char* args[]) {
+	parseArgs(argc, args);
+	if (!options.shmName.empty() && !sharedState.open(options.shmName)) std::cerr << "c8ke - Error creating shared memory " << options.shmName << std::endl;
+
 	c8ke emu;
-	emu.reset();
+	emu.vipTiming = options.vipTiming;
+	emu.reset(newSeed());
+	if (options.headless) return runHeadless(emu);
+	if (!romPath.empty()) c8keState = RELOAD;
+	if (!options.timelinePath.empty()) timeline.record(true);
 
 	init();
+	if (options.gdbPort && !gdb.start(options.gdbPort)) SDL_Log("c8ke could not listen for gdb on port %u", options.gdbPort);
 	run(emu);
 	shutdown();
 
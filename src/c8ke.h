@@ -1,35 +1,51 @@
 #pragma once
 
-// custom definitions
-using byte = unsigned char; // 8 bits, 1 byte
-using word = unsigned short; // 16 bits, 2 bytes
-
 // emulator values
-const unsigned short CLK = 500; // 500 Hz, 500 cycles/sec
-const double TIME_PER_CYCLE = 1000000000.0 / CLK;
-const unsigned char FPS = 60; // 60 FPS, 60 frames/sec
-const double TIME_PER_REFRESH = 1000000000.0 / FPS;
-const unsigned short MAX_MEM = 4096; // 4KB memory, 4096 bites
-const unsigned short START_ADDRESS = 0x200; // memory start address
 std::string romPath = "";
 
+// command line options
+struct Options {
+	bool headless = false; // run without a window, as fast as possible
+	bool hasSeed = false;
+	uint64_t seed = 0; // rng seed, random unless given
+	long long frames = 60 * 60; // headless run length, one minute by default
+	std::string inputsPath; // headless key masks, one hex value per frame
+	uint32_t sampleInterval = 0; // cycles between call stack samples, 0 to disable
+	std::string foldedPath; // folded stacks output for flamegraphs
+	std::string pprofPath; // pprof profile output
+	std::string tracePath; // binary execution trace output
+	std::string timelinePath; // host timing zones, written on exit
+	std::string coveragePath; // headless rom coverage map
+	uint16_t gdbPort = 0; // gdb remote stub on localhost, 0 for none
+	std::string shmName; // shared memory segment for external tools
+	Platform platform = AUTO; // --platform or the Settings menu, AUTO goes by the extension and the code
+	bool vipTiming = false; // --vip-timing or the Settings menu, chip8 runs at the vip's speed
+	std::string vipRomPath; // 512 byte monitor rom image for the low level vip
+	std::string vipInterpreterPath; // chip8 interpreter image, loaded at 0000 of the vip's RAM
+	bool lle = false; // headless run on the low level vip instead of the core
+	bool oracle = false; // headless lockstep of the core against the low level vip
+};
+Options options;
+
 // display values
-const unsigned char WIDTH = 64; // original interpreter screen width
-const unsigned char HEIGHT = 32; // original interpreter screen height
-byte screen[HEIGHT][WIDTH] = { 0 }; // original interpreter screen
 float SCALE = 11; // scale emulator screen for modern monitors
 int WINDOW_WIDTH = 1000; // actual window width
 int WINDOW_HEIGHT = 800; // actual window heights
 
 // audio values
-const int DEFAULT_BEEP_AMOUNT = 100; // beep parameter 1
-const int DEFAULT_BEEP_PHASE = 2200; // beep parameter 2
-int current_sine_sample = 0; // something for the beep
+const int DEFAULT_BEEP_TONE = 2200; // Hz
+const int DEFAULT_BEEP_VOLUME = 50; // percent
+const int DEFAULT_BEEP_ATTACK = 4; // ms to fade in
+const int DEFAULT_BEEP_RELEASE = 8; // ms to fade out
 struct CustomAudio {
-	int beepAmount = DEFAULT_BEEP_AMOUNT; 
-	int beepPhase = DEFAULT_BEEP_PHASE; 
+	int tone = DEFAULT_BEEP_TONE;
+	int volume = DEFAULT_BEEP_VOLUME;
+	int attack = DEFAULT_BEEP_ATTACK;
+	int release = DEFAULT_BEEP_RELEASE;
+	bool sync = false; // pace the emulation by the audio device instead of the wall clock
 };
 CustomAudio customAudio;
+Beeper beeper; // pulled by the audio device, see audio.h
 
 // state machine for the emulator
 enum State {
@@ -42,6 +58,7 @@ enum State {
 	HALT,
 	DELAY_HALT,
 	RESET,
+	BREAK, // stopped by a breakpoint or watchpoint, machine and timers frozen
 };
 static State c8keState = INIT;
 
@@ -52,8 +69,6 @@ std::unordered_map<SDL_Keycode, byte> keymap = {
 		{SDLK_A, 0x7}, {SDLK_S, 0x8}, {SDLK_D, 0x9}, {SDLK_F, 0xE},
 		{SDLK_Z, 0xA}, {SDLK_X, 0x0}, {SDLK_C, 0xB}, {SDLK_V, 0xF},
 };
-bool input[16] = { 0 }; // has pressed keys
-byte tempReg = 0; // needed for one input instruction
 byte chip8Keys[4][4] = { // for drawing debug controls
 	{0x1, 0x2, 0x3, 0xC},
 	{0x4, 0x5, 0x6, 0xD},
@@ -61,36 +76,80 @@ byte chip8Keys[4][4] = { // for drawing debug controls
 	{0xA, 0x0, 0xB, 0xF},
 };
 
-// default chip8 sprites
-const unsigned char SPRITE_ADDRESS = 0x50; // beginning sprite address in memory
-const unsigned char TOTAL_SPRITE_SIZE = 80; // total number of bytes the sprites take up
-byte sprites[TOTAL_SPRITE_SIZE] = { // sprites to store in memory
-			0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-			0x20, 0x60, 0x20, 0x20, 0x70, // 1
-			0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-			0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-			0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-			0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-			0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-			0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-			0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-			0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-			0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-			0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-			0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-			0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-			0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-			0xF0, 0x80, 0xF0, 0x80, 0x80, // D
+// profiling, only runs the instrumented core while enabled
+bool profiling = false;
+Profiler profiler;
+TraceWriter tracer;
+
+// pacing overlay, the monitor always runs since it only costs a few adds per frame
+bool showPerf = false;
+PerfMonitor perf;
+
+// memory heatmap, counts accesses while the window is open
+bool showHeatmap = false;
+MemoryHeatmap heatmap;
+const int HEATMAP_WIDTH = 64; // bytes per texture row
+const float HEATMAP_DECAY = 0.92f; // heat kept per frame, about half a second to fade
+
+// breakpoints and watchpoints, the core only goes through the probe while any are set
+bool showBreakpoints = false;
+Breakpoints breakpoints;
+
+// cached disassembly, only updated while the window is open
+bool showDisassembly = false;
+Disassembly disassembly;
+
+// remote debugging, the stub's thread only sleeps on its socket until a client talks
+GdbServer gdb;
+
+// state published to other processes each frame, see c8ke_shm.h
+SharedState sharedState;
+
+// snapshots and input log for stepping backwards, always recording
+History history;
+
+// probe handed to cycle() while any debug tool is on, tools left null are skipped
+struct DebugProbe {
+	Profiler* profiler = nullptr;
+	Sampler* sampler = nullptr;
+	TraceWriter* trace = nullptr;
+	MemoryHeatmap* heatmap = nullptr;
+	Breakpoints* breakpoints = nullptr;
+
+	bool any() const { return profiler || sampler || trace || heatmap || breakpoints; }
+
+	void execute(word pc, word instruction) {
+		if (profiler) profiler->execute(pc, instruction);
+		if (sampler) sampler->execute(pc, instruction);
+		if (trace) trace->execute(pc, instruction);
+		if (heatmap) heatmap->execute(pc, instruction);
+		if (breakpoints) breakpoints->execute(pc, instruction);
+	}
+
+	void retire(const c8ke& emu) {
+		if (trace) trace->retire(emu);
+		if (breakpoints) breakpoints->retire(emu);
+	}
+
+	void read(word address, word count) {
+		if (heatmap) heatmap->read(address, count);
+		if (breakpoints) breakpoints->read(address, count);
+	}
+
+	void write(word address, word count) {
+		if (heatmap) heatmap->write(address, count);
+		if (breakpoints) breakpoints->write(address, count);
+	}
 };
 
-
 // SDL
 SDL_Window* window = nullptr;
 SDL_Renderer* renderer = nullptr;
 SDL_Texture* texture = nullptr;
+SDL_Texture* heatTexture = nullptr; // one texel per memory byte
 SDL_Surface* icon = nullptr;
 SDL_AudioStream* stream = nullptr;
-SDL_AudioSpec spec = { SDL_AUDIO_F32, 1, 8000 }; // format, channels, frequency
+SDL_AudioSpec spec = { SDL_AUDIO_F32, 1, 48000 }; // format, channels, frequency (replaced by the device rate)
 SDL_Event e;
 
 
@@ -122,6 +181,25 @@ const ImVec4 DEFAULT_DEBUG_BG = ImVec4(0.0f, 0.0f, 0.0f, 1.0f); // black
 const ImVec4 DEFAULT_DEBUG_HEADER_FG = ImVec4(1.0f, 1.0f, 1.0f, 1.0f); // white
 const ImVec4 DEFAULT_DEBUG_HEADER_BG = ImVec4(0.0f, 0.0f, 0.0f, 1.0f); // black
 
+// palette indices 2-15, only xo-chip roms drawing to more than one plane use them.
+// 0 and 1 are the emulator bg and fg above
+const Uint8 XO_PALETTE[14][3] = {
+	{ 0x55, 0xAA, 0xFF }, // blue, plane 1 alone
+	{ 0xFF, 0xFF, 0xFF }, // white, planes 0 and 1
+	{ 0xAA, 0x22, 0x55 }, // plum
+	{ 0xFF, 0x44, 0x44 }, // red
+	{ 0x22, 0xAA, 0x55 }, // green
+	{ 0xFF, 0xEE, 0x55 }, // yellow
+	{ 0x22, 0x44, 0x88 }, // navy
+	{ 0xAA, 0x66, 0x22 }, // brown
+	{ 0x55, 0x55, 0x55 }, // dark gray
+	{ 0x99, 0x99, 0x99 }, // light gray
+	{ 0x88, 0xDD, 0xCC }, // teal
+	{ 0xDD, 0x88, 0xEE }, // lilac
+	{ 0x44, 0x22, 0x11 }, // dark brown
+	{ 0xCC, 0xEE, 0x99 }, // lime
+};
+
 struct CustomColors {
 	ImVec4 emuFg = DEFAULT_EMULATOR_FG;
 	ImVec4 emuBg = DEFAULT_EMULATOR_BG;
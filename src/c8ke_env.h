@@ -0,0 +1,94 @@
+#pragma once
+
+/*
+ * C interface to the vectorized c8ke environment, for loading the headless
+ * core from external trainers (ctypes, cffi, etc).
+ *
+ * Observations are written straight into the caller's buffer, one frame per
+ * instance back to back. A frame is either 64x32 bytes (one byte per pixel,
+ * 0 or 1) or 32 rows of 8 bytes with the leftmost pixel in the high bit.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+	#if defined(C8KE_ENV_EXPORTS)
+		#define C8KE_API __declspec(dllexport)
+	#else
+		#define C8KE_API __declspec(dllimport)
+	#endif
+#else
+	#define C8KE_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct c8ke_env c8ke_env;
+
+typedef struct c8ke_env_config {
+	int num_envs; /* parallel instances */
+	int frame_skip; /* 60 Hz frames emulated per step, the action is held for all of them */
+	float sticky_prob; /* chance per frame to keep the previous action instead of the new one */
+	int packed; /* nonzero for 1 bit per pixel observations */
+	int threads; /* worker threads, 0 for one per core */
+	int max_frames; /* episode length limit in frames, 0 for none */
+	int reward_addr; /* memory address whose change is the reward, -1 for none */
+	int done_addr; /* episode ends when mem[done_addr] == done_value, -1 for none */
+	int done_value;
+	int platform; /* 0 CHIP-8, 1 CHIP-48, 2 SUPER-CHIP 1.1, 3 XO-CHIP, 4 MegaChip, -1 to go by the rom's extension and code */
+} c8ke_env_config;
+
+/* called after every step on each instance, from worker threads */
+typedef float (*c8ke_reward_fn)(int index, const uint8_t* mem, const uint8_t* regs, void* user);
+typedef int (*c8ke_done_fn)(int index, const uint8_t* mem, const uint8_t* regs, void* user);
+
+C8KE_API void c8ke_env_default_config(c8ke_env_config* config);
+
+/* returns NULL if the rom can't be read */
+C8KE_API c8ke_env* c8ke_env_create(const char* rom_path, const c8ke_env_config* config);
+C8KE_API void c8ke_env_destroy(c8ke_env* env);
+
+C8KE_API int c8ke_env_num_envs(const c8ke_env* env);
+C8KE_API size_t c8ke_env_obs_size(const c8ke_env* env); /* bytes per instance */
+
+/* hooks override reward_addr / done_addr, pass NULL to go back to them */
+C8KE_API void c8ke_env_set_hooks(c8ke_env* env, c8ke_reward_fn reward, c8ke_done_fn done, void* user);
+
+/* seeds holds num_envs values, obs receives num_envs frames (may be NULL) */
+C8KE_API void c8ke_env_reset(c8ke_env* env, const uint64_t* seeds, uint8_t* obs);
+
+/*
+ * actions holds num_envs 16-bit key masks (bit n = key n held). Finished
+ * instances are reset before returning and obs holds their first frame.
+ * obs, rewards and dones may be NULL.
+ */
+C8KE_API void c8ke_env_step(c8ke_env* env, const uint16_t* actions, uint8_t* obs, float* rewards, uint8_t* dones);
+
+/* snapshot of an instance's memory, 4 KB or 64 KB for XO-CHIP and MegaChip, valid until the next call on that instance */
+C8KE_API const uint8_t* c8ke_env_memory(c8ke_env* env, int index);
+
+/*
+ * Brute force input search for tool assisted runs. Tries every key mask in
+ * breadth first order from a fresh boot until mem[goal_addr] >= goal_value,
+ * skipping states that were already reached.
+ */
+typedef struct c8ke_search_config {
+	int frames_per_input; /* frames each input is held for */
+	int max_depth; /* inputs before giving up */
+	int max_frontier; /* states kept per depth */
+	int threads; /* worker threads, 0 for one per core */
+	int goal_addr;
+	int goal_value;
+} c8ke_search_config;
+
+C8KE_API void c8ke_search_default_config(c8ke_search_config* config);
+
+/* returns the length of the found sequence (at most max_inputs are written), or -1 if the goal wasn't reached or the rom can't be read */
+C8KE_API int c8ke_search(const char* rom_path, uint64_t seed, const c8ke_search_config* config, uint16_t* inputs, int max_inputs);
+
+#ifdef __cplusplus
+}
+#endif
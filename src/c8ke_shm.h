@@ -0,0 +1,59 @@
+#pragma once
+
+/*
+ * Layout of the shared memory segment c8ke publishes with --shm NAME, for
+ * dashboards, bots and capture tools that want the machine state without
+ * scraping the window. The segment is named NAME (POSIX shm_open, a leading
+ * slash is added if missing) or NAME as a Windows file mapping, and is
+ * rewritten once per 60 Hz frame.
+ *
+ * Reads are guarded by a seqlock instead of a lock, so the emulator never
+ * waits on a reader and a reader never makes a syscall:
+ *
+ *   do {
+ *       start = shm->sequence;           (odd means a frame is being written)
+ *       ...read the fields you need...
+ *   } while ((start & 1) || shm->sequence != start);
+ *
+ * with an acquire fence after the first load and before the second one in
+ * languages that reorder loads.
+ */
+
+#include <stdint.h>
+
+#define C8KE_SHM_MAGIC 0x534B3843u /* "C8KS" */
+#define C8KE_SHM_VERSION 4
+
+typedef struct c8ke_shm {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size; /* sizeof(c8ke_shm), grows only at the end */
+	volatile uint32_t sequence; /* seqlock, odd while a frame is being written */
+	uint64_t frame; /* frames published since the segment was created */
+
+	uint16_t pc;
+	uint16_t i;
+	uint8_t sp; /* 0xFF when the stack is empty */
+	uint8_t delay_timer;
+	uint8_t sound_timer;
+	uint8_t waiting; /* nonzero while blocked on Fx0A */
+	uint8_t regs[16];
+	uint16_t stack[16];
+	uint16_t keys; /* bit n set while key n is held */
+	uint16_t reserved[3];
+
+	uint8_t mem[4096];
+	uint8_t pixels[32][64]; /* one byte per pixel, 0 or 1, row major. hires screens keep every other pixel and row */
+
+	/* version 2 */
+	uint16_t width; /* 64 or 128 (schip hires) */
+	uint16_t height; /* 32 or 64 */
+	uint16_t reserved2[2];
+	uint8_t display[64][128]; /* the screen at its own resolution in the top left width x height, palette index 0-15 since version 3 */
+
+	/* version 3 */
+	uint8_t planes; /* xo-chip Fx01 plane mask, 1 for plain chip8 and schip */
+	uint8_t platform; /* since version 4: 0 CHIP-8, 1 CHIP-48, 2 SUPER-CHIP 1.1, 3 XO-CHIP, 4 MegaChip */
+	uint8_t reserved3[6];
+	uint8_t high_mem[0x10000 - 4096]; /* xo-chip memory past mem[], 0x1000-0xFFFF */
+} c8ke_shm;
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "core.h"
+
+/***** breakpoint conditions *****/
+
+// expressions like "V3 == 0x10 && I > 0x300" or "hits > 100", parsed once
+// into a small stack bytecode so a conditional breakpoint on a hot loop costs
+// a few dozen switch dispatches per hit instead of a parse.
+//
+//   operands:  V0-VF  I  PC  SP  DT  ST  hits  numbers (123, 0x7B)  mem[expr]
+//   operators: ( )  ! ~ -  * / %  + -  << >>  < <= > >=  == !=  &  ^  |  &&  ||
+class Condition {
+public:
+	std::string text;
+
+	// false with a message on a syntax error, the condition is left empty
+	bool compile(const std::string& source, std::string& error) {
+		text = source;
+		code.clear();
+		input = source.c_str();
+		at = 0;
+		depth = 0;
+		maxDepth = 0;
+		failure.clear();
+
+		parseBinary(0);
+		skipSpace();
+		if (failure.empty() && input[at] != '\0') fail("unexpected '" + std::string(1, input[at]) + "'");
+		if (failure.empty() && maxDepth > STACK_SIZE) fail("expression too deep");
+		input = ""; // source may not outlive us
+		if (!failure.empty()) {
+			error = failure;
+			code.clear();
+			return false;
+		}
+		return true;
+	}
+
+	bool empty() const { return code.empty(); }
+
+	// nonzero means break
+	int32_t evaluate(const c8ke& emu, uint64_t hits) const {
+		int32_t stack[STACK_SIZE];
+		int sp = -1;
+		for (const Op& op : code) {
+			switch (op.code) {
+			case PUSH: stack[++sp] = op.value; break;
+			case REG: stack[++sp] = emu.regs[op.value]; break;
+			case IREG: stack[++sp] = emu.iReg; break;
+			case PC: stack[++sp] = emu.pc; break;
+			case SP: stack[++sp] = (emu.sp == 0xFF) ? -1 : emu.sp; break;
+			case DT: stack[++sp] = emu.delayReg; break;
+			case ST: stack[++sp] = emu.soundReg; break;
+			case HITS: stack[++sp] = (int32_t)hits; break;
+			case MEM: stack[sp] = emu.mem[(word)stack[sp]]; break;
+			case NOT: stack[sp] = !stack[sp]; break;
+			case INVERT: stack[sp] = ~stack[sp]; break;
+			case NEGATE: stack[sp] = (int32_t)(0u - (uint32_t)stack[sp]); break;
+			default: {
+				int32_t b = stack[sp--];
+				int32_t& a = stack[sp];
+				// arithmetic wraps like the 32-bit registers it mimics, INT32_MIN / -1 included
+				switch (op.code) {
+				case MUL: a = (int32_t)((uint32_t)a * (uint32_t)b); break;
+				case DIV: a = b == -1 ? (int32_t)(0u - (uint32_t)a) : b ? a / b : 0; break;
+				case MOD: a = b == -1 || !b ? 0 : a % b; break;
+				case ADD: a = (int32_t)((uint32_t)a + (uint32_t)b); break;
+				case SUB: a = (int32_t)((uint32_t)a - (uint32_t)b); break;
+				case SHL: a = (int32_t)((uint32_t)a << (b & 31)); break;
+				case SHR: a = (int32_t)((uint32_t)a >> (b & 31)); break;
+				case LT: a = a < b; break;
+				case LE: a = a <= b; break;
+				case GT: a = a > b; break;
+				case GE: a = a >= b; break;
+				case EQ: a = a == b; break;
+				case NE: a = a != b; break;
+				case AND: a &= b; break;
+				case XOR: a ^= b; break;
+				case OR: a |= b; break;
+				case LAND: a = a && b; break;
+				case LOR: a = a || b; break;
+				default: break;
+				}
+			} break;
+			}
+		}
+		return sp >= 0 ? stack[sp] : 1;
+	}
+
+private:
+	enum Code : byte {
+		PUSH, REG, IREG, PC, SP, DT, ST, HITS, MEM, NOT, INVERT, NEGATE,
+		MUL, DIV, MOD, ADD, SUB, SHL, SHR, LT, LE, GT, GE, EQ, NE, AND, XOR, OR, LAND, LOR,
+	};
+
+	struct Op {
+		Code code;
+		int32_t value;
+	};
+
+	struct Binary {
+		const char* token;
+		int precedence;
+		Code code;
+	};
+
+	static const int STACK_SIZE = 32;
+
+	// longest tokens first so "<=" isn't read as "<"
+	static const Binary* binaries() {
+		static const Binary table[] = {
+			{ "||", 1, LOR }, { "&&", 2, LAND }, { "==", 6, EQ }, { "!=", 6, NE }, { "<=", 7, LE }, { ">=", 7, GE },
+			{ "<<", 8, SHL }, { ">>", 8, SHR }, { "|", 3, OR }, { "^", 4, XOR }, { "&", 5, AND }, { "<", 7, LT },
+			{ ">", 7, GT }, { "+", 9, ADD }, { "-", 9, SUB }, { "*", 10, MUL }, { "/", 10, DIV }, { "%", 10, MOD },
+			{ nullptr, 0, PUSH },
+		};
+		return table;
+	}
+
+	void emit(Code op, int32_t value = 0, int stackChange = 0) {
+		code.push_back({ op, value });
+		depth += stackChange;
+		if (depth > maxDepth) maxDepth = depth;
+	}
+
+	void fail(const std::string& message) {
+		if (failure.empty()) failure = message + " at column " + std::to_string(at + 1);
+	}
+
+	void skipSpace() {
+		while (input[at] == ' ' || input[at] == '\t') at++;
+	}
+
+	bool accept(const char* token) {
+		skipSpace();
+		size_t length = std::strlen(token);
+		if (std::strncmp(input + at, token, length) != 0) return false;
+		at += length;
+		return true;
+	}
+
+	// precedence climbing, every operator is left associative
+	void parseBinary(int minPrecedence) {
+		parseUnary();
+		while (failure.empty()) {
+			skipSpace();
+			const Binary* found = nullptr;
+			for (const Binary* b = binaries(); b->token; b++) {
+				if (std::strncmp(input + at, b->token, std::strlen(b->token)) == 0) { found = b; break; }
+			}
+			if (!found || found->precedence < minPrecedence) return;
+
+			at += std::strlen(found->token);
+			parseBinary(found->precedence + 1);
+			emit(found->code, 0, -1);
+		}
+	}
+
+	void parseUnary() {
+		if (accept("!")) { parseUnary(); emit(NOT); return; }
+		if (accept("~")) { parseUnary(); emit(INVERT); return; }
+		if (accept("-")) { parseUnary(); emit(NEGATE); return; }
+		parsePrimary();
+	}
+
+	void parsePrimary() {
+		skipSpace();
+		if (accept("(")) {
+			parseBinary(0);
+			if (!accept(")")) fail("expected ')'");
+			return;
+		}
+
+		if (std::isdigit((unsigned char)input[at])) {
+			char* end = nullptr;
+			long value = std::strtol(input + at, &end, 0);
+			at = end - input;
+			emit(PUSH, (int32_t)value, 1);
+			return;
+		}
+
+		size_t start = at;
+		while (std::isalnum((unsigned char)input[at])) at++;
+		std::string name(input + start, at - start);
+		for (char& c : name) c = (char)std::toupper((unsigned char)c);
+
+		if (name.size() == 2 && name[0] == 'V' && std::isxdigit((unsigned char)name[1])) emit(REG, std::stoi(name.substr(1), nullptr, 16), 1);
+		else if (name == "I") emit(IREG, 0, 1);
+		else if (name == "PC") emit(PC, 0, 1);
+		else if (name == "SP") emit(SP, 0, 1);
+		else if (name == "DT") emit(DT, 0, 1);
+		else if (name == "ST") emit(ST, 0, 1);
+		else if (name == "HITS") emit(HITS, 0, 1);
+		else if (name == "MEM") {
+			if (!accept("[")) { fail("expected '['"); return; }
+			parseBinary(0);
+			if (!accept("]")) { fail("expected ']'"); return; }
+			emit(MEM);
+		} else if (name.empty()) fail("expected a value");
+		else fail("unknown name '" + name + "'");
+	}
+
+	std::vector<Op> code;
+
+	// parser state, only used while compiling
+	const char* input = "";
+	size_t at = 0;
+	int depth = 0;
+	int maxDepth = 0;
+	std::string failure;
+};
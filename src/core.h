@@ -0,0 +1,1413 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+	#include <emmintrin.h>
+	#define C8KE_SSE2 1
+#endif
+
+// custom definitions
+using byte = unsigned char; // 8 bits, 1 byte
+using word = unsigned short; // 16 bits, 2 bytes
+
+// emulator values
+const unsigned char FPS = 60; // 60 FPS, 60 frames/sec
+const double TIME_PER_REFRESH = 1000000000.0 / FPS;
+const int MAX_MEM = 0x10000; // 64KB xo-chip address space, the 4KB platforms only see the first 4KB
+const unsigned short START_ADDRESS = 0x200; // memory start address
+const unsigned short PAGE_SIZE = 1024; // copy-on-write granularity
+const unsigned short PAGE_COUNT = MAX_MEM / PAGE_SIZE;
+
+// display values
+const unsigned char WIDTH = 64; // original interpreter screen width
+const unsigned char HEIGHT = 32; // original interpreter screen height
+const unsigned char HIRES_WIDTH = 128; // schip 00FF screen width
+const unsigned char HIRES_HEIGHT = 64; // schip 00FF screen height
+const unsigned char PLANES = 4; // xo-chip bitplanes, a pixel's color is one bit from each
+const byte ALL_PLANES = (1 << PLANES) - 1;
+const unsigned short MEGA_WIDTH = 256; // megachip 0011 screen width
+const unsigned short MEGA_HEIGHT = 192; // megachip 0011 screen height
+
+// default chip8 sprites
+const unsigned char SPRITE_ADDRESS = 0x50; // beginning sprite address in memory
+const unsigned char TOTAL_SPRITE_SIZE = 80; // total number of bytes the sprites take up
+
+// xo-chip audio values
+const unsigned char PATTERN_SIZE = 16; // 128 one bit samples loaded by F002
+const unsigned char DEFAULT_PITCH = 64; // Fx3A value for 4000 samples/sec
+const byte sprites[TOTAL_SPRITE_SIZE] = { // sprites to store in memory
+			0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+			0x20, 0x60, 0x20, 0x20, 0x70, // 1
+			0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+			0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+			0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+			0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+			0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+			0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+			0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+			0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+			0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+			0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+			0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+			0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+			0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+			0xF0, 0x80, 0xF0, 0x80, 0x80, // D
+};
+
+// schip 8x10 digits for Fx30, right after the small ones
+const unsigned char BIG_SPRITE_ADDRESS = SPRITE_ADDRESS + TOTAL_SPRITE_SIZE;
+const unsigned char TOTAL_BIG_SPRITE_SIZE = 160;
+const byte bigSprites[TOTAL_BIG_SPRITE_SIZE] = {
+			0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+			0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+			0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+			0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+			0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+			0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+			0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+			0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+			0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+			0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+			0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+			0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+			0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+			0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+			0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+			0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0, // F
+};
+
+
+
+/***** state hashing *****/
+
+// splitmix64 finalizer
+inline uint64_t mix64(uint64_t z) {
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+// zobrist style keys, a state's hash is the xor of one key per memory byte and
+// screen row so a write only has to swap the old key for the new one. zero
+// maps to zero so cleared memory and a blank screen hash to 0.
+inline uint64_t memKey(unsigned addr, byte value) {
+	return value ? mix64(((uint64_t)addr << 8) | value) : 0;
+}
+
+inline uint64_t rowKey(int y, uint64_t bits) {
+	return bits ? mix64(bits + (uint64_t)(y + 1) * 0x9E3779B97F4A7C15ull) : 0;
+}
+
+
+
+/***** paged memory *****/
+
+// guest memory split into reference counted pages. copying a Memory shares
+// every page and a write only duplicates the page it lands in, so forking a
+// machine costs the pages it dirties afterwards instead of the full 64KB.
+// reads never allocate, writes check one refcount.
+class Memory {
+public:
+	Memory() {
+		for (int i = 0; i < PAGE_COUNT; i++) pages[i] = new Page();
+	}
+
+	Memory(const Memory& other) : hash(other.hash) {
+		for (int i = 0; i < PAGE_COUNT; i++) {
+			pages[i] = other.pages[i];
+			pages[i]->refs.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	Memory& operator=(const Memory& other) {
+		if (this == &other) return *this;
+		for (int i = 0; i < PAGE_COUNT; i++) {
+			other.pages[i]->refs.fetch_add(1, std::memory_order_relaxed);
+			release(pages[i]);
+			pages[i] = other.pages[i];
+		}
+		hash = other.hash;
+		return *this;
+	}
+
+	~Memory() {
+		for (int i = 0; i < PAGE_COUNT; i++) release(pages[i]);
+	}
+
+	byte operator[](unsigned addr) const {
+		addr &= MAX_MEM - 1;
+		return pages[addr / PAGE_SIZE]->data[addr % PAGE_SIZE];
+	}
+
+	void write(unsigned addr, byte value) {
+		addr &= MAX_MEM - 1;
+		byte& cell = own(addr / PAGE_SIZE)->data[addr % PAGE_SIZE];
+		hash ^= memKey(addr, cell) ^ memKey(addr, value);
+		cell = value;
+	}
+
+	void write(unsigned addr, const byte* data, size_t size) {
+		for (size_t i = 0; i < size; i++) write(addr + (unsigned)i, data[i]);
+	}
+
+	// zeroes memory without touching pages other machines still use
+	void clear() {
+		for (int i = 0; i < PAGE_COUNT; i++) std::memset(own(i)->data, 0, PAGE_SIZE);
+		hash = 0;
+	}
+
+	void copyTo(byte* out) const {
+		for (int i = 0; i < PAGE_COUNT; i++) std::memcpy(out + i * PAGE_SIZE, pages[i]->data, PAGE_SIZE);
+	}
+
+	// flat copy of [start, start + size), for consumers that only want part of it
+	void copyTo(byte* out, unsigned start, unsigned size) const {
+		while (size) {
+			unsigned addr = start & (MAX_MEM - 1);
+			unsigned chunk = std::min(size, (unsigned)PAGE_SIZE - addr % PAGE_SIZE);
+			std::memcpy(out, pages[addr / PAGE_SIZE]->data + addr % PAGE_SIZE, chunk);
+			out += chunk;
+			start += chunk;
+			size -= chunk;
+		}
+	}
+
+	int sharedPages() const {
+		int shared = 0;
+		for (int i = 0; i < PAGE_COUNT; i++) shared += pages[i]->refs.load(std::memory_order_relaxed) > 1;
+		return shared;
+	}
+
+	uint64_t hash = 0; // xor of memKey() over every byte, kept up to date by write()
+
+private:
+	struct Page {
+		std::atomic<int> refs{ 1 };
+		byte data[PAGE_SIZE]{};
+	};
+
+	static void release(Page* page) {
+		if (page->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete page;
+	}
+
+	// makes page i private to this machine before it is written
+	Page* own(int i) {
+		Page* page = pages[i];
+		if (page->refs.load(std::memory_order_acquire) == 1) return page;
+
+		Page* copy = new Page();
+		std::memcpy(copy->data, page->data, PAGE_SIZE);
+		release(page);
+		pages[i] = copy;
+		return copy;
+	}
+
+	Page* pages[PAGE_COUNT];
+};
+
+
+
+/***** bitplane display *****/
+
+// the 128x64 screen, one bit per pixel per plane. a row is 128 bits in two
+// words with x = 0 in the high bit of [0]. the 4KB of planes would be most of
+// a fork, so like Memory they are reference counted and only duplicated when a
+// shared copy is written. reads index it like the plain array, writes go
+// through plane() which takes a private copy first.
+class PlaneScreen {
+public:
+	using Plane = uint64_t[HIRES_HEIGHT][2];
+
+	PlaneScreen() : data(new Data()) {}
+
+	PlaneScreen(const PlaneScreen& other) : data(other.data) {
+		data->refs.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	PlaneScreen& operator=(const PlaneScreen& other) {
+		if (this == &other) return *this;
+		other.data->refs.fetch_add(1, std::memory_order_relaxed);
+		release(data);
+		data = other.data;
+		return *this;
+	}
+
+	~PlaneScreen() { release(data); }
+
+	const Plane& operator[](int p) const { return data->planes[p]; }
+
+	Plane& plane(int p) { return own()->planes[p]; }
+
+	// zeroes the planes in mask. clearing all of a shared block just starts a new one
+	void clear(byte mask) {
+		if (mask == ALL_PLANES && data->refs.load(std::memory_order_acquire) != 1) {
+			release(data);
+			data = new Data();
+			return;
+		}
+		for (int p = 0; p < PLANES; p++) if (mask & (1 << p)) std::memset(plane(p), 0, sizeof(Plane));
+	}
+
+private:
+	struct Data {
+		std::atomic<int> refs{ 1 };
+		Plane planes[PLANES]{};
+	};
+
+	static void release(Data* d) {
+		if (d->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete d;
+	}
+
+	Data* own() {
+		if (data->refs.load(std::memory_order_acquire) == 1) return data;
+
+		Data* copy = new Data();
+		std::memcpy(copy->planes, data->planes, sizeof(copy->planes));
+		release(data);
+		data = copy;
+		return copy;
+	}
+
+	Data* data;
+};
+
+
+
+/***** megachip display *****/
+
+// the 256x192 megachip screen. sprites are one palette index per pixel, the
+// index buffer keeps what was drawn last for collisions and the color buffer
+// the blended result. the screen is double buffered, 00E0 shows the frame
+// drawn so far and starts a blank one.
+//
+// 430KB of buffers is too much to copy with every fork, so like Memory the
+// whole block is reference counted and only duplicated when a shared copy is
+// written. machines that never run 0011 don't allocate it at all.
+//
+// blits run a row at a time: the palette lookup fills a row of source colors,
+// then the indices are merged and the colors blended 16 and 4 pixels per step.
+// both paths use the same integer math so a run hashes the same either way.
+class MegaScreen {
+public:
+	enum Blend : byte { NORMAL, ALPHA_25, ALPHA_50, ALPHA_75, ADD, MULTIPLY }; // 080n
+
+	MegaScreen() {}
+
+	MegaScreen(const MegaScreen& other) : data(other.data) {
+		if (data) data->refs.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	MegaScreen& operator=(const MegaScreen& other) {
+		if (this == &other) return *this;
+		if (other.data) other.data->refs.fetch_add(1, std::memory_order_relaxed);
+		release(data);
+		data = other.data;
+		return *this;
+	}
+
+	~MegaScreen() { release(data); }
+
+	bool active() const { return data != nullptr; }
+
+	// 0011, a blank screen with an empty palette
+	void enable() {
+		release(data);
+		data = new Data();
+	}
+
+	// 0010, back to the bitplane screen
+	void disable() {
+		release(data);
+		data = nullptr;
+	}
+
+	// xor of a key per loaded palette entry and per 8 pixel chunk of the back buffer
+	uint64_t hash() const { return data ? data->paletteHash ^ data->screenHash : 0; }
+
+	// rgba texels of the last shown frame, MEGA_WIDTH per row
+	const uint32_t* front() const { return &data->color[data->front][0][0]; }
+
+	// 02nn: count ARGB colors from memory into entries 1 to count, 0 stays transparent
+	void loadPalette(const Memory& mem, word address, int count) {
+		Data* d = own();
+		for (int i = 1; i <= count; i++) {
+			unsigned at = address + (i - 1) * 4;
+			byte rgba[4] = { mem[at + 1], mem[at + 2], mem[at + 3], mem[at] };
+			uint32_t color;
+			std::memcpy(&color, rgba, 4);
+			d->paletteHash ^= paletteKey(i, d->palette[i]) ^ paletteKey(i, color);
+			d->palette[i] = color;
+		}
+	}
+
+	// 00E0
+	void flip() {
+		Data* d = own();
+		d->front ^= 1;
+		std::memset(d->color[d->front ^ 1], 0, sizeof(d->color[0]));
+		std::memset(d->index, 0, sizeof(d->index));
+		d->screenHash = 0;
+	}
+
+	// 00Bn/00Cn/00FB/00FC, positive is right and down
+	void scroll(int dx, int dy) {
+		Data* d = own();
+		shift(d->color[d->front ^ 1], dx, dy);
+		shift(d->index, dx, dy);
+		d->screenHash = 0;
+		for (int y = 0; y < MEGA_HEIGHT; y++) d->screenHash ^= rowHash(d, y, 0, MEGA_WIDTH);
+	}
+
+	// Dxyn in megachip mode: a width x height sprite of palette indices from
+	// memory, index 0 is transparent and anything past the right or bottom edge
+	// is clipped. true if a pixel landed on one of the collision color
+	bool blit(const Memory& mem, word address, int x, int y, int width, int height, byte blend, byte collision) {
+		Data* d = own();
+		int cols = std::min(width, MEGA_WIDTH - x);
+		int rows = std::min(height, MEGA_HEIGHT - y);
+		int weight = (blend >= ALPHA_25 && blend <= ALPHA_75) ? blend : 4; // opacity in quarters
+		alignas(16) byte indices[MEGA_WIDTH];
+		alignas(16) uint32_t colors[MEGA_WIDTH];
+		bool hit = false;
+
+		for (int row = 0; row < rows; row++) {
+			mem.copyTo(indices, address + row * width, cols);
+			for (int i = 0; i < cols; i++) colors[i] = d->palette[indices[i]];
+
+			uint64_t before = rowHash(d, y + row, x, cols);
+			hit |= mergeIndices(d->index[y + row] + x, indices, cols, collision);
+			blendRow(d->color[d->front ^ 1][y + row] + x, colors, cols, blend, weight);
+			d->screenHash ^= before ^ rowHash(d, y + row, x, cols);
+		}
+		return hit;
+	}
+
+private:
+	struct Data {
+		std::atomic<int> refs{ 1 };
+		uint32_t palette[256]{};
+		byte index[MEGA_HEIGHT][MEGA_WIDTH]{};
+		uint32_t color[2][MEGA_HEIGHT][MEGA_WIDTH]{};
+		int front = 0;
+		uint64_t paletteHash = 0;
+		uint64_t screenHash = 0;
+	};
+
+	static void release(Data* d) {
+		if (d && d->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete d;
+	}
+
+	Data* own() {
+		if (data->refs.load(std::memory_order_acquire) == 1) return data;
+
+		Data* copy = new Data();
+		std::memcpy(copy->palette, data->palette, sizeof(copy->palette));
+		std::memcpy(copy->index, data->index, sizeof(copy->index));
+		std::memcpy(copy->color, data->color, sizeof(copy->color));
+		copy->front = data->front;
+		copy->paletteHash = data->paletteHash;
+		copy->screenHash = data->screenHash;
+		release(data);
+		data = copy;
+		return copy;
+	}
+
+	static uint64_t paletteKey(int i, uint32_t color) {
+		return color ? mix64(((uint64_t)(i + 1) << 32 | color) * 0xD6E8FEB86659FD93ull) : 0;
+	}
+
+	// keys of the 8 pixel chunks of row y covering [x, x + count)
+	static uint64_t rowHash(const Data* d, int y, int x, int count) {
+		uint64_t h = 0;
+		for (int c = x >> 3; c <= (x + count - 1) >> 3; c++) {
+			uint64_t words[5];
+			std::memcpy(words, &d->color[d->front ^ 1][y][c * 8], 32);
+			std::memcpy(&words[4], &d->index[y][c * 8], 8);
+			if (!(words[0] | words[1] | words[2] | words[3] | words[4])) continue;
+			uint64_t k = (uint64_t)(y * (MEGA_WIDTH / 8) + c + 1) * 0x9E3779B97F4A7C15ull;
+			for (int i = 0; i < 5; i++) k = mix64(k ^ words[i]);
+			h ^= k;
+		}
+		return h;
+	}
+
+	template <class T>
+	static void shift(T (*rows)[MEGA_WIDTH], int dx, int dy) {
+		const size_t line = sizeof(rows[0]);
+		if (dy > 0) {
+			std::memmove(rows[dy], rows[0], line * (MEGA_HEIGHT - dy));
+			std::memset(rows[0], 0, line * dy);
+		} else if (dy < 0) {
+			std::memmove(rows[0], rows[-dy], line * (MEGA_HEIGHT + dy));
+			std::memset(rows[MEGA_HEIGHT + dy], 0, line * -dy);
+		}
+		for (int y = 0; y < MEGA_HEIGHT && dx; y++) {
+			if (dx > 0) {
+				std::memmove(rows[y] + dx, rows[y], sizeof(T) * (MEGA_WIDTH - dx));
+				std::memset(rows[y], 0, sizeof(T) * dx);
+			} else {
+				std::memmove(rows[y], rows[y] - dx, sizeof(T) * (MEGA_WIDTH + dx));
+				std::memset(rows[y] + MEGA_WIDTH + dx, 0, sizeof(T) * -dx);
+			}
+		}
+	}
+
+	// drawn pixels replace the index under them, collision color 0 means none
+	static bool mergeIndices(byte* dst, const byte* src, int count, byte collision) {
+		int hit = 0, i = 0;
+#if C8KE_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i target = _mm_set1_epi8((char)collision);
+		for (; i + 16 <= count; i += 16) {
+			__m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+			__m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+			__m128i clear = _mm_cmpeq_epi8(s, zero);
+			hit |= _mm_movemask_epi8(_mm_andnot_si128(clear, _mm_cmpeq_epi8(d, target)));
+			_mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_and_si128(clear, d), _mm_andnot_si128(clear, s)));
+		}
+#endif
+		for (; i < count; i++) {
+			if (!src[i]) continue;
+			hit |= dst[i] == collision;
+			dst[i] = src[i];
+		}
+		return hit && collision;
+	}
+
+	// out = (effect * a + dst * (256 - a)) >> 8 per channel, with a the source
+	// alpha stretched to 0-256 and scaled by the opacity. the effect is the
+	// source itself, the saturated sum or the product, and 255 for alpha so the
+	// screen's own alpha is plain "over" coverage. a transparent pixel has a = 0
+	// and leaves dst exactly as it was.
+	static void blendRow(uint32_t* dst, const uint32_t* src, int count, byte blend, int weight) {
+		int i = 0;
+#if C8KE_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i full = _mm_set1_epi16(256);
+		const __m128i quarters = _mm_set1_epi16((short)weight);
+		const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+		const __m128i alphaLanes = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+		for (; i + 4 <= count; i += 4) {
+			__m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+			__m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+			__m128i e = _mm_or_si128((blend == ADD) ? _mm_adds_epu8(d, s) : s, opaque);
+			__m128i halves[2];
+			for (int h = 0; h < 2; h++) {
+				__m128i s16 = h ? _mm_unpackhi_epi8(s, zero) : _mm_unpacklo_epi8(s, zero);
+				__m128i d16 = h ? _mm_unpackhi_epi8(d, zero) : _mm_unpacklo_epi8(d, zero);
+				__m128i e16 = h ? _mm_unpackhi_epi8(e, zero) : _mm_unpacklo_epi8(e, zero);
+				if (blend == MULTIPLY) e16 = _mm_or_si128(_mm_srli_epi16(_mm_mullo_epi16(d16, _mm_add_epi16(s16, _mm_set1_epi16(1))), 8), alphaLanes);
+				__m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s16, 0xFF), 0xFF); // each pixel's alpha in all four lanes
+				a = _mm_add_epi16(a, _mm_srli_epi16(a, 7));
+				a = _mm_srli_epi16(_mm_mullo_epi16(a, quarters), 2);
+				__m128i mixed = _mm_add_epi16(_mm_mullo_epi16(e16, a), _mm_mullo_epi16(d16, _mm_sub_epi16(full, a)));
+				halves[h] = _mm_srli_epi16(mixed, 8);
+			}
+			_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(halves[0], halves[1]));
+		}
+#endif
+		for (; i < count; i++) {
+			byte s[4], d[4], out[4];
+			std::memcpy(s, &src[i], 4);
+			std::memcpy(d, &dst[i], 4);
+			int a = s[3] + (s[3] >> 7);
+			a = (a * weight) >> 2;
+			for (int c = 0; c < 4; c++) {
+				int effect = (c == 3) ? 255 : (blend == ADD) ? std::min(d[c] + s[c], 255) : (blend == MULTIPLY) ? (d[c] * (s[c] + 1)) >> 8 : s[c];
+				out[c] = (byte)((effect * a + d[c] * (256 - a)) >> 8);
+			}
+			std::memcpy(&dst[i], out, 4);
+		}
+	}
+
+	Data* data = nullptr;
+};
+
+
+
+/***** platforms *****/
+
+// every platform runs its own copy of the interpreter, instantiated from the
+// same opcode code with that platform's row of this table as constants. the
+// opcodes it doesn't have and the quirks it doesn't use compile away, so no
+// handler ever asks which platform it is running on.
+enum Platform : byte { CHIP8, CHIP48, SCHIP, XOCHIP, MEGACHIP, PLATFORMS, AUTO = PLATFORMS };
+
+const char* const platformNames[PLATFORMS] = { "CHIP-8", "CHIP-48", "SUPER-CHIP 1.1", "XO-CHIP", "MegaChip" };
+
+struct Quirks {
+	int memory; // bytes, addresses wrap here
+	unsigned short clock; // instructions/sec
+	bool schip; // 00Cn, 00FB-00FF, Dxy0, Fx30, Fx75 and Fx85
+	bool xochip; // F000 nnnn, Fx01, 5xy2/5xy3, 00Dn, F002 and Fx3A
+	bool megachip; // 0010/0011, 00Bn and 01nn-09nn once 0011 ran
+	bool logicResetsVF; // 8xy1/8xy2/8xy3 clear VF
+	bool shiftsVy; // 8xy6/8xyE shift Vy into Vx instead of shifting Vx in place
+	byte loadStoreStep; // Fx55/Fx65 leave i at i + x + 1 (2), i + x (1) or where it was (0)
+	bool jumpsVx; // Bxnn jumps to xnn + Vx instead of nnn + V0
+	bool wraps; // sprites wrap around the screen edges instead of clipping
+	bool countsRows; // hires Dxyn sets VF to the colliding rows plus the clipped ones
+};
+
+// chip8 is the cosmac vip, chip-48 and schip the hp48 ones and megachip keeps
+// schip's quirks. the clocks are the usual defaults, roms for the later
+// platforms expect a much faster machine. the chip8 row is exactly what the
+// interpreter did before there were platforms: 8xy6/8xyE shift Vy into Vx,
+// 8xy1-3 clear VF, Fx55/Fx65 leave I past the last register, Bnnn adds V0 and
+// sprites clip, so plain .ch8 roms run as they always have.
+constexpr Quirks QUIRKS[PLATFORMS] = {
+	//  memory   clock  schip  xo     mega   vf     vy     i  vx     wrap   rows
+	{   0x1000,    500, false, false, false, true,  true,  2, false, false, false }, // CHIP8
+	{   0x1000,    500, false, false, false, false, false, 1, true,  false, false }, // CHIP48
+	{   0x1000,   1800, true,  false, false, false, false, 0, true,  false, true  }, // SCHIP
+	{  MAX_MEM,  60000, true,  true,  false, false, true,  2, false, true,  false }, // XOCHIP
+	{  MAX_MEM,  60000, true,  false, true,  false, false, 0, false, false, true  }, // MEGACHIP
+};
+
+
+
+/***** cosmac vip timing *****/
+
+// optional timing model for chip8, in 1802 machine cycles (8 clocks of the
+// vip's 1.76 MHz crystal). a 60 Hz frame is 3668 of them and the interrupt
+// routine takes half, since it stays busy repeating lines for the 1861 until
+// the whole 64x32 screen has been shown, so the interpreter gets the rest.
+// every instruction pays the fetch and dispatch plus its own cost, a few also
+// depend on their operands. figures are from disassembly of the vip
+// interpreter, close but not cycle exact.
+const int VIP_FRAME_CYCLES = 3668;
+const int VIP_INTERRUPT_CYCLES = 1832;
+const int VIP_FETCH_CYCLES = 68;
+const int VIP_CLEAR_CYCLES = 3068; // 00E0 zeroing the 256 byte display page
+
+// by first nibble. 0 is 00EE, skips add 4 when taken
+constexpr unsigned short VIP_CYCLES[16] = { 10, 12, 26, 10, 10, 14, 6, 10, 44, 14, 12, 22, 36, 26, 14, 10 };
+
+// the most instructions a frame can hold, host calls past the frame's budget
+// idle until the next interrupt
+const unsigned short VIP_CLOCK = ((VIP_FRAME_CYCLES - VIP_INTERRUPT_CYCLES) / (VIP_FETCH_CYCLES + 6) + 1) * FPS;
+
+
+
+/***** emulator core *****/
+
+struct c8ke;
+
+// instrumentation hooks for cycle(). tools pass their own probe type and the
+// calls are resolved at compile time, so plain cycle() has no extra cost.
+// probes derive from this and only hide the hooks they care about.
+struct NoProbe {
+	void execute(word pc, word instruction) {} // after fetch, before the instruction runs
+	void retire(const c8ke& emu) {} // after the instruction ran
+	void read(word address, word count) {} // data reads by Dxyn, F002, 5xy3, Fx65 and the megachip 02nn/060n, fetches go through execute()
+	void write(word address, word count) {} // Fx33, 5xy2 and Fx55
+};
+
+// sound changes as the core makes them, stamped with the instruction they
+// happened at, so the audio side can place them within a frame without
+// looking at the sound state after every instruction
+enum SoundKind : byte { SOUND_GATE, SOUND_VOICE, SOUND_SAMPLE };
+struct SoundEvent {
+	uint64_t at; // c8ke::executed when it happened
+	SoundKind kind;
+	byte value; // GATE: the sound timer, VOICE: the pitch, SAMPLE: sampleId
+};
+const int SOUND_EVENTS = 32; // ring size, a reader further behind than this resyncs from the state
+
+// the core has no SDL or ImGui dependencies so it can be shared by the
+// frontend and the headless environment library
+struct c8ke {
+	word instruction{}; // current instruction
+	word pc{}; // 16-bit program counter
+	byte sp{}; // 8-bit stack pointer, 0xFF when empty and never past 15
+
+	word stack[16]{}; // 16 16-bit values
+	byte regs[16]{}; // 16 8-bit registers
+	Memory mem; // program memory
+
+	word iReg{}; // 16-bit i register
+	byte delayReg{}; // 8-bit delay timer register
+	byte soundReg{}; // 8-bit sound timer register
+	byte pattern[PATTERN_SIZE]{}; // xo-chip audio buffer, played msb first while the sound timer runs
+	byte pitch = DEFAULT_PITCH; // pattern playback rate is 4000 * 2^((pitch - 64) / 48) samples/sec
+	bool usesPattern{}; // F002 ran since reset, until then the buzzer is the plain beep
+
+	// lores only uses the top left 64x32, so [0] of rows 0-31 of plane 0 is the
+	// original interpreter screen, and the schip scrolls are word shifts and row
+	// moves. shared with forks until one of them draws
+	PlaneScreen screen;
+	uint64_t screenHash{}; // xor of rowHash() over every plane and row
+	bool hires{}; // schip 128x64 mode, 00FF/00FE
+	byte planes = 1; // xo-chip Fx01 mask, drawing, clearing and scrolling only touch these
+	MegaScreen mega; // megachip 0011 display, replaces the bitplanes while active
+	byte spriteWidth{}; // megachip 03nn, 0 is 256
+	byte spriteHeight{}; // megachip 04nn, 0 is 256
+	byte blendMode{}; // megachip 080n, a MegaScreen::Blend
+	byte collisionColor{}; // megachip 09nn, palette index that sets VF when drawn over
+	byte screenAlpha = 255; // megachip 05nn, fades the shown screen
+	word sampleAddress{}; // megachip 060n sample data, 8 bit unsigned pcm
+	word sampleLength{}; // bytes, clipped to the end of memory
+	word sampleRate{}; // samples/sec
+	bool sampleLoop{}; // 0600 loops, 0601 plays once
+	bool samplePlaying{}; // until 0700, a one shot sample isn't tracked to its end
+	byte sampleId{}; // bumped by every 060n and 0700 so the audio side sees restarts
+	byte rpl[16]{}; // schip Fx75/Fx85 flag registers
+	bool input[16]{}; // has pressed keys
+	bool waiting{}; // blocked on Fx0A until a key is released
+	byte waitReg{}; // register Fx0A stores the key in
+	uint64_t rngState{}; // per instance so runs are reproducible from a seed
+	byte frameRemainder{}; // clock() / FPS isn't whole, frame() carries the fraction
+	word romSize{}; // bytes loaded at START_ADDRESS
+	Platform platform = CHIP8; // engine cycle() runs, survives reset(seed)
+	bool vipTiming{}; // chip8 runs on the vip's cycle costs instead of a fixed rate, survives reset(seed)
+	int vipBudget{}; // machine cycles left before the next interrupt, negative when an instruction ran past it
+	uint64_t executed{}; // instructions run, never reset so sound stamps only move forward
+	SoundEvent soundEvents[SOUND_EVENTS]{};
+	uint32_t soundHead{}; // sound events written so far, the newest is at (soundHead - 1) % SOUND_EVENTS
+
+	// switching platforms is only clean on a fresh machine, so it goes through here or loadRom()
+	void reset(uint64_t seed, Platform target) {
+		platform = target;
+		reset(seed);
+	}
+
+	void reset(uint64_t seed = 0) {
+		// reset values
+		instruction = 0;
+		pc = START_ADDRESS;
+		sp = -1;
+		iReg = 0;
+		delayReg = 0;
+		if (soundReg > 0) sound(SOUND_GATE, 0);
+		soundReg = 0;
+		std::memset(pattern, 0, sizeof(pattern));
+		pitch = DEFAULT_PITCH;
+		usesPattern = false;
+		for (byte i = 0; i < 16; i++) {
+			stack[i] = 0;
+			regs[i] = 0;
+			input[i] = false;
+			rpl[i] = 0;
+		}
+		hires = false;
+		planes = 1;
+		mega.disable();
+		spriteWidth = 0;
+		spriteHeight = 0;
+		blendMode = 0;
+		collisionColor = 0;
+		screenAlpha = 255;
+		sampleAddress = 0;
+		sampleLength = 0;
+		sampleRate = 0;
+		sampleLoop = false;
+		samplePlaying = false;
+		sampleId = 0;
+		sound(SOUND_SAMPLE, 0);
+		mem.clear();
+		clear();
+		waiting = false;
+		waitReg = 0;
+		rngState = seed;
+		frameRemainder = 0;
+		romSize = 0;
+		vipBudget = VIP_FRAME_CYCLES - VIP_INTERRUPT_CYCLES;
+		sound(SOUND_VOICE, pitch); // back to the plain beep
+
+		// load sprites into memory
+		mem.write(SPRITE_ADDRESS, sprites, TOTAL_SPRITE_SIZE);
+		mem.write(BIG_SPRITE_ADDRESS, bigSprites, TOTAL_BIG_SPRITE_SIZE);
+	}
+
+	// cheap copy for tree search, memory pages are shared until either side writes them
+	c8ke fork() const {
+		return *this;
+	}
+
+	// copies a rom image into memory, anything past the end of memory is dropped
+	void load(const byte* data, size_t size) {
+		size_t total = (size < (size_t)(MAX_MEM - START_ADDRESS)) ? size : (size_t)(MAX_MEM - START_ADDRESS);
+		mem.write(START_ADDRESS, data, total);
+		romSize = (word)total;
+		pc = START_ADDRESS;
+	}
+
+	// AUTO goes by the file extension, and for the ones every platform uses
+	// (.ch8, .bin) asks guess to look at the code. without one it's plain chip8
+	bool loadRom(const std::string& path, Platform choice = AUTO, Platform (*guess)(const c8ke&) = nullptr) {
+		std::vector<byte> rom;
+		if (!readRom(path, rom)) return false;
+		load(rom.data(), rom.size());
+		platform = (choice != AUTO) ? choice : platformFor(path);
+		if (platform == AUTO) platform = guess ? guess(*this) : CHIP8;
+		return true;
+	}
+
+	// AUTO when the extension doesn't say
+	static Platform platformFor(const std::string& path) {
+		size_t dot = path.find_last_of('.');
+		if (dot == std::string::npos) return AUTO;
+		std::string ext = path.substr(dot + 1);
+		std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return (char)std::tolower((unsigned char)c); });
+		if (ext == "c48" || ext == "ch48") return CHIP48;
+		if (ext == "sc8" || ext == "schip") return SCHIP;
+		if (ext == "xo8") return XOCHIP;
+		if (ext == "mc8") return MEGACHIP;
+		return AUTO;
+	}
+
+	static bool readRom(std::string path, std::vector<byte>& out) {
+		std::ifstream rom(path, std::ios::binary); // open file in binary mode
+		if (!rom.is_open()) return false;
+		out.assign(std::istreambuf_iterator<char>(rom), std::istreambuf_iterator<char>());
+		return true;
+	}
+
+	void clear(byte mask = ALL_PLANES) {
+		screen.clear(mask);
+		if (mask == ALL_PLANES) screenHash = 0;
+		else rehash();
+	}
+
+	int width() const { return hires ? HIRES_WIDTH : WIDTH; }
+	int height() const { return hires ? HIRES_HEIGHT : HEIGHT; }
+
+	unsigned short clock() const { return timed() ? VIP_CLOCK : QUIRKS[platform].clock; }
+	bool timed() const { return vipTiming && platform == CHIP8; }
+	int memorySize() const { return QUIRKS[platform].memory; }
+
+	// the right half of each row is keyed as if it were 64 rows further down,
+	// and each plane another 128 rows below that
+	uint64_t rowHash(int p, int y) const {
+		int key = p * HIRES_HEIGHT * 2 + y;
+		return rowKey(key, screen[p][y][0]) ^ rowKey(key + HIRES_HEIGHT, screen[p][y][1]);
+	}
+
+	// after a scroll touched every row anyway
+	void rehash() {
+		screenHash = 0;
+		for (int p = 0; p < PLANES; p++) for (int y = 0; y < HIRES_HEIGHT; y++) screenHash ^= rowHash(p, y);
+	}
+
+	// 64-bit hash of everything that affects future execution. memory and the
+	// screen are hashed incrementally as they are written, the ~60 bytes of
+	// registers are cheaper to fold in here than to track on every instruction.
+	uint64_t hash() const {
+		uint64_t words[16];
+		words[0] = pc | ((uint64_t)iReg << 16) | ((uint64_t)sp << 32) | ((uint64_t)delayReg << 40) | ((uint64_t)soundReg << 48) | ((uint64_t)waitReg << 56) | ((uint64_t)waiting << 63);
+		words[1] = rngState;
+		std::memcpy(&words[2], regs, sizeof(regs));
+		std::memcpy(&words[4], stack, sizeof(stack));
+		words[8] = frameRemainder;
+		for (int i = 0; i < 16; i++) words[8] |= (uint64_t)input[i] << (8 + i);
+		words[8] |= ((uint64_t)pitch << 24) | ((uint64_t)usesPattern << 32) | ((uint64_t)hires << 33) | ((uint64_t)planes << 34);
+		std::memcpy(&words[9], pattern, sizeof(pattern));
+		std::memcpy(&words[11], rpl, sizeof(rpl));
+		words[13] = spriteWidth | ((uint64_t)spriteHeight << 8) | ((uint64_t)blendMode << 16) | ((uint64_t)collisionColor << 24) | ((uint64_t)screenAlpha << 32) | ((uint64_t)mega.active() << 40) | ((uint64_t)platform << 48);
+		words[14] = sampleAddress | ((uint64_t)sampleLength << 16) | ((uint64_t)sampleRate << 32) | ((uint64_t)sampleLoop << 48) | ((uint64_t)samplePlaying << 49) | ((uint64_t)sampleId << 56);
+		words[15] = (uint32_t)vipBudget | ((uint64_t)vipTiming << 32);
+
+		uint64_t h = mem.hash ^ screenHash ^ mega.hash();
+		for (int i = 0; i < 16; i++) h = mix64(h ^ words[i]);
+		return h;
+	}
+
+	// palette index of a pixel, bit p comes from plane p
+	byte color(int x, int y) const {
+		int shift = 63 - (x & 63);
+		byte c = 0;
+		for (int p = 0; p < PLANES; p++) c |= ((screen[p][y][x >> 6] >> shift) & 1) << p;
+		return c;
+	}
+
+	// pixels lit in any plane, half 0 is x = 0-63
+	uint64_t lit(int y, int half) const {
+		return screen[0][y][half] | screen[1][y][half] | screen[2][y][half] | screen[3][y][half];
+	}
+
+	// row y of a 64x32 view, hires screens keep every other pixel of every other
+	// row. for consumers with a fixed lores layout (shm, env observations)
+	uint64_t loresRow(int y) const {
+		if (!hires) return lit(y, 0);
+		return (evenBits(lit(y * 2, 0)) << 32) | evenBits(lit(y * 2, 1));
+	}
+
+	// key state changes go through here so Fx0A can finish on release
+	void press(byte key, bool pressed) {
+		input[key] = pressed;
+		if (waiting && !pressed) {
+			regs[waitReg] = key;
+			waiting = false;
+		}
+	}
+
+	// 60 Hz timer update, the vblank interrupt. with vip timing it also starts
+	// the next frame's budget, an overrun carries over but idle time doesn't
+	void tick() {
+		if (delayReg > 0) delayReg--;
+		if (soundReg > 0 && --soundReg == 0) sound(SOUND_GATE, 0);
+		if (vipTiming) vipBudget = std::min(vipBudget, 0) + VIP_FRAME_CYCLES - VIP_INTERRUPT_CYCLES;
+	}
+
+	void sound(SoundKind kind, byte value) {
+		soundEvents[soundHead++ % SOUND_EVENTS] = { executed, kind, value };
+	}
+
+	// one 60 Hz frame with the keys in the mask held (bit n = key n), for headless runs
+	void frame(uint16_t keys) {
+		NoProbe probe;
+		frame(keys, probe);
+	}
+
+	template <class Probe>
+	void frame(uint16_t keys, Probe& probe) {
+		for (byte k = 0; k < 16; k++) {
+			bool pressed = (keys >> k) & 1;
+			if (pressed != input[k]) press(k, pressed);
+		}
+
+		frameRemainder += clock() % FPS;
+		int cycles = clock() / FPS;
+		if (frameRemainder >= FPS) { frameRemainder -= FPS; cycles++; }
+		switch (platform) { // once per frame instead of once per instruction
+		case CHIP8:
+			if (vipTiming) { while (vipBudget > 0 && !waiting) execute<CHIP8, true>(probe); } // as many as the budget holds
+			else run<CHIP8>(cycles, probe);
+			break;
+		case CHIP48: run<CHIP48>(cycles, probe); break;
+		case SCHIP: run<SCHIP>(cycles, probe); break;
+		case XOCHIP: run<XOCHIP>(cycles, probe); break;
+		case MEGACHIP: run<MEGACHIP>(cycles, probe); break;
+		default: break;
+		}
+
+		tick();
+	}
+
+	template <Platform P, class Probe>
+	void run(int cycles, Probe& probe) {
+		for (int i = 0; i < cycles; i++) execute<P>(probe);
+	}
+
+	// the 32 pixels at even x of a 64 pixel word, packed into the low half
+	static uint64_t evenBits(uint64_t v) {
+		v = (v >> 1) & 0x5555555555555555ull; // x = 0 is the high bit, so even x sit at odd bit positions
+		v = (v | (v >> 1)) & 0x3333333333333333ull;
+		v = (v | (v >> 2)) & 0x0F0F0F0F0F0F0F0Full;
+		v = (v | (v >> 4)) & 0x00FF00FF00FF00FFull;
+		v = (v | (v >> 8)) & 0x0000FFFF0000FFFFull;
+		return (v | (v >> 16)) & 0x00000000FFFFFFFFull;
+	}
+
+	// F000 nnnn and the megachip 01nn nnnn are four bytes long, skips have to step over all of it
+	template <Platform P>
+	void skip() {
+		constexpr Quirks q = QUIRKS[P];
+		bool longLoad = false;
+		if constexpr (q.xochip) longLoad = mem[pc] == 0xF0 && mem[pc + 1] == 0x00;
+		if constexpr (q.megachip) longLoad = mem[pc] == 0x01 && mega.active();
+		pc = (word)((pc + (longLoad ? 4 : 2)) & (q.memory - 1));
+	}
+
+	// splitmix64, cheap and fine for any seed including 0
+	byte random() {
+		return (byte)(mix64(rngState += 0x9E3779B97F4A7C15ull) >> 56);
+	}
+
+	void cycle() {
+		NoProbe probe;
+		cycle(probe);
+	}
+
+	// one instruction on the engine of the current platform. a single branch
+	// here, nothing below tests the platform again
+	template <class Probe>
+	void cycle(Probe& probe) {
+		switch (platform) {
+		case CHIP8:
+			if (!vipTiming) execute<CHIP8>(probe);
+			else if (vipBudget > 0) execute<CHIP8, true>(probe); // otherwise waiting for the interrupt
+			break;
+		case CHIP48: execute<CHIP48>(probe); break;
+		case SCHIP: execute<SCHIP>(probe); break;
+		case XOCHIP: execute<XOCHIP>(probe); break;
+		case MEGACHIP: execute<MEGACHIP>(probe); break;
+		default: break;
+		}
+	}
+
+	// machine cycles the vip interpreter spends on an instruction, from the
+	// registers it starts with. taken skips are added by execute()
+	int vipCycles(word op) const {
+		int x = (op >> 8) & 0xF;
+		int cycles = VIP_FETCH_CYCLES + VIP_CYCLES[op >> 12];
+		switch (op >> 12) {
+		case 0x0:
+			if (op == 0x00E0) cycles += VIP_CLEAR_CYCLES;
+			break;
+		case 0xD: // each row is shifted into place unless x is byte aligned
+			cycles += (op & 0xF) * ((regs[x] & 7) ? 68 : 46);
+			break;
+		case 0xF:
+			switch (op & 0xFF) {
+			case 0x0A: cycles += 8; break;
+			case 0x1E: case 0x29: cycles += 6; break;
+			case 0x33: cycles += 74 + 16 * (regs[x] / 100 + regs[x] / 10 % 10 + regs[x] % 10); break; // counts down each digit
+			case 0x55: case 0x65: cycles += 4 + 14 * (x + 1); break;
+			}
+			break;
+		}
+		return cycles;
+	}
+
+	// the interpreter, one instantiation per platform. opcodes outside the
+	// platform's set fall through as no-ops and every address wraps at its
+	// memory size. Timed bills vipCycles() to the frame's budget
+	template <Platform P, bool Timed = false, class Probe>
+	void execute(Probe& probe) {
+		constexpr Quirks q = QUIRKS[P];
+		constexpr unsigned mask = q.memory - 1;
+		constexpr int planeCount = q.xochip ? PLANES : 1; // the others only ever draw to plane 0
+		if (waiting) return;
+
+		executed++;
+		instruction = (mem[pc] << 8) | mem[(pc + 1) & mask];
+		probe.execute(pc, instruction);
+		int cost = Timed ? vipCycles(instruction) : 0;
+		word next = (word)((pc + 2) & mask);
+		pc = next;
+
+		switch (instruction & 0xF000) { // checks the first nibble
+		case 0x0000: { // 00**
+			if constexpr (q.megachip) {
+				if (instruction >= 0x0100 && mega.active()) { // 01nn-09nn
+					megachip(probe);
+					break;
+				}
+				if ((instruction & 0xFFF0) == 0x00B0 && mega.active()) { // 00Bn: scroll the display up n rows (megachip)
+					mega.scroll(0, -(instruction & 0x000F));
+					break;
+				}
+			}
+			if constexpr (q.schip) {
+				if ((instruction & 0xFFF0) == 0x00C0) { // 00Cn: scroll the display down n rows
+					int n = instruction & 0x000F;
+					if constexpr (q.megachip) if (mega.active()) { mega.scroll(0, n); break; }
+					for (int p = 0; p < planeCount; p++) {
+						if (!(planes & (1 << p))) continue;
+						PlaneScreen::Plane& rows = screen.plane(p);
+						std::memmove(rows[n], rows[0], sizeof(rows[0]) * (height() - n));
+						std::memset(rows[0], 0, sizeof(rows[0]) * n);
+					}
+					rehash();
+					break;
+				}
+			}
+			if constexpr (q.xochip) {
+				if ((instruction & 0xFFF0) == 0x00D0) { // 00Dn: scroll the display up n rows (xo-chip)
+					int n = instruction & 0x000F;
+					for (int p = 0; p < planeCount; p++) {
+						if (!(planes & (1 << p))) continue;
+						PlaneScreen::Plane& rows = screen.plane(p);
+						std::memmove(rows[0], rows[n], sizeof(rows[0]) * (height() - n));
+						std::memset(rows[height() - n], 0, sizeof(rows[0]) * n);
+					}
+					rehash();
+					break;
+				}
+			}
+			switch (instruction) {
+			case 0x00E0: // 00E0: clear the selected planes. megachip shows the frame and starts the next one
+				if constexpr (q.megachip) if (mega.active()) { mega.flip(); break; }
+				if constexpr (q.xochip) clear(planes);
+				else clear();
+				break;
+			case 0x0010: // 0010: leave megachip mode
+				if constexpr (q.megachip) {
+					mega.disable();
+					clear();
+				}
+				break;
+			case 0x0011: // 0011: enter megachip mode
+				if constexpr (q.megachip) mega.enable();
+				break;
+			case 0x00EE: // 00EE: return from a subroutine. sp stays 0xFF (empty) or 0-15 however the rom calls
+				pc = stack[sp & 0xF];
+				sp = sp == 0 ? 0xFF : (byte)((sp - 1) & 0xF);
+				break;
+			case 0x00FB: // 00FB: scroll the display right 4 pixels
+				if constexpr (q.schip) {
+					if constexpr (q.megachip) if (mega.active()) { mega.scroll(4, 0); break; }
+					for (int p = 0; p < planeCount; p++) {
+						if (!(planes & (1 << p))) continue;
+						PlaneScreen::Plane& rows = screen.plane(p);
+						for (int y = 0; y < height(); y++) {
+							if (hires) rows[y][1] = (rows[y][1] >> 4) | (rows[y][0] << 60);
+							rows[y][0] >>= 4;
+						}
+					}
+					rehash();
+				}
+				break;
+			case 0x00FC: // 00FC: scroll the display left 4 pixels
+				if constexpr (q.schip) {
+					if constexpr (q.megachip) if (mega.active()) { mega.scroll(-4, 0); break; }
+					for (int p = 0; p < planeCount; p++) {
+						if (!(planes & (1 << p))) continue;
+						PlaneScreen::Plane& rows = screen.plane(p);
+						for (int y = 0; y < height(); y++) {
+							rows[y][0] = (rows[y][0] << 4) | (rows[y][1] >> 60);
+							rows[y][1] <<= 4;
+						}
+					}
+					rehash();
+				}
+				break;
+			case 0x00FD: // 00FD: exit the interpreter, parked on this instruction
+				if constexpr (q.schip) pc -= 2;
+				break;
+			case 0x00FE: // 00FE: lores 64x32 display
+				if constexpr (q.schip) {
+					hires = false;
+					clear();
+				}
+				break;
+			case 0x00FF: // 00FF: hires 128x64 display
+				if constexpr (q.schip) {
+					hires = true;
+					clear();
+				}
+				break;
+			}
+		} break;
+
+		case 0x1000: { // 1nnn: jump to location nnn
+			pc = instruction & 0x0FFF;
+		} break;
+
+		case 0x2000: { // 2nnn: call subroutine at nnn, a 17th level overwrites the oldest
+			sp = (byte)((sp + 1) & 0xF);
+			stack[sp] = pc;
+			pc = instruction & 0x0FFF;
+		} break;
+
+		case 0x3000: { // 3xkk: skip next instruction if Vx = kk
+			if (regs[(instruction & 0x0F00) >> 8] == (instruction & 0x00FF)) skip<P>();
+		} break;
+
+		case 0x4000: { // 4xkk: skip next instruction if Vx != kk
+			if (regs[(instruction & 0x0F00) >> 8] != (instruction & 0x00FF)) skip<P>();
+		} break;
+
+		case 0x5000: { // 5xy*
+			byte x = (instruction & 0x0F00) >> 8;
+			byte y = (instruction & 0x00F0) >> 4;
+			switch (instruction & 0x000F) {
+			case 0x0: // 5xy0: skip next instruction if Vx = Vy
+				if (regs[x] == regs[y]) skip<P>();
+				break;
+			case 0x2: // 5xy2: store Vx through Vy in memory starting at location i, i is unchanged (xo-chip)
+				if constexpr (q.xochip) {
+					int n = (x < y ? y - x : x - y) + 1; // the range runs either way
+					int dir = (x < y) ? 1 : -1;
+					probe.write(iReg, (word)n);
+					for (int i = 0; i < n; i++) mem.write(iReg + i, regs[x + i * dir]);
+				}
+				break;
+			case 0x3: // 5xy3: read Vx through Vy from memory starting at location i, i is unchanged (xo-chip)
+				if constexpr (q.xochip) {
+					int n = (x < y ? y - x : x - y) + 1;
+					int dir = (x < y) ? 1 : -1;
+					probe.read(iReg, (word)n);
+					for (int i = 0; i < n; i++) regs[x + i * dir] = mem[iReg + i];
+				}
+				break;
+			}
+		} break;
+
+		case 0x6000: { // 6xkk: set Vx = kk
+			regs[(instruction & 0x0F00) >> 8] = (instruction & 0x00FF);
+		} break;
+
+		case 0x7000: { // 7xkk: set Vx = Vx + kk
+			regs[(instruction & 0x0F00) >> 8] += (instruction & 0x00FF);
+		} break;
+
+		case 0x8000: { // 8xy*
+			byte x = (instruction & 0x0F00) >> 8;
+			byte y = (instruction & 0x00F0) >> 4;
+			switch (instruction & 0x000F) {
+			case 0x0: // 8xy0: set Vx = Vy
+				regs[x] = regs[y];
+				break;
+			case 0x1: // 8xy1: set Vx = Vx OR Vy
+				regs[x] |= regs[y];
+				if constexpr (q.logicResetsVF) regs[0xF] = 0;
+				break;
+			case 0x2: // 8xy2: set Vx = Vx AND Vy
+				regs[x] &= regs[y];
+				if constexpr (q.logicResetsVF) regs[0xF] = 0;
+				break;
+			case 0x3: // 8xy3: set Vx = Vx XOR Vy
+				regs[x] ^= regs[y];
+				if constexpr (q.logicResetsVF) regs[0xF] = 0;
+				break;
+			case 0x4: { // 8xy4: set Vx = Vx + Vy, set VF = carry
+				word sum = regs[x] + regs[y];
+				regs[x] = sum & 0xFF;
+				regs[0xF] = (sum > 0xFF) ? 1 : 0;
+			} break;
+			case 0x5: {// 8xy5: set Vx = Vx - Vy, set VF = NOT borrow
+				byte originalX = regs[x];
+				regs[x] -= regs[y];
+				regs[0xF] = (originalX >= regs[y]) ? 1 : 0;
+			} break;
+			case 0x6: {// 8xy6: set Vx = Vy SHR 1, or Vx SHR 1 on the hp48 platforms
+				byte source = q.shiftsVy ? regs[y] : regs[x];
+				regs[x] = source >> 1;
+				regs[0xF] = source & 0x1;
+			} break;
+			case 0x7: { // 8xy7: set Vx = Vy - Vx, set VF = NOT borrow
+				byte originalX = regs[x];
+				regs[x] = regs[y] - regs[x];
+				regs[0xF] = (regs[y] >= originalX) ? 1 : 0;
+			} break;
+			case 0xE: { // 8xyE: set Vx = Vy SHL 1, or Vx SHL 1 on the hp48 platforms
+				byte source = q.shiftsVy ? regs[y] : regs[x];
+				regs[x] = (byte)(source << 1);
+				regs[0xF] = (source & 0x80) >> 7;
+			} break;
+			}
+		} break;
+
+		case 0x9000: { // 9xy0: skip next insruction if Vx != Vy
+			if ((regs[(instruction & 0x0F00) >> 8]) != (regs[(instruction & 0x00F0) >> 4])) skip<P>();
+		} break;
+
+		case 0xA000: { // Annn: set i = nnn
+			iReg = instruction & 0x0FFF;
+		} break;
+
+		case 0xB000: { // Bnnn: jump to location nnn + V0, Bxnn jumps to xnn + Vx on the hp48 platforms
+			byte offset = q.jumpsVx ? regs[(instruction & 0x0F00) >> 8] : regs[0];
+			pc = (word)(((instruction & 0x0FFF) + offset) & mask);
+		} break;
+
+		case 0xC000: { // Cxkk: set Vx = random byte AND kk
+			regs[(instruction & 0x0F00) >> 8] = random() & (instruction & 0x00FF);
+		} break;
+
+		case 0xD000: { // Dxyn: display n-byte sprite starting at memory location I at (Vx, Vy), set VF = collision. Dxy0 is 16x16 (schip)
+			if constexpr (q.megachip) {
+				if (mega.active()) { // megachip ignores n, the sprite is spriteWidth x spriteHeight indices
+					int w = spriteWidth ? spriteWidth : 256;
+					int h = spriteHeight ? spriteHeight : 256;
+					probe.read(iReg, (word)std::min(w * h, 0xFFFF));
+					regs[0xF] = mega.blit(mem, iReg, regs[(instruction & 0x0F00) >> 8], regs[(instruction & 0x00F0) >> 4], w, h, blendMode, collisionColor) ? 1 : 0;
+					break;
+				}
+			}
+			const int w = q.schip ? width() : WIDTH;
+			const int h = q.schip ? height() : HEIGHT;
+			int x = regs[(instruction & 0x0F00) >> 8] % w;
+			int y = regs[(instruction & 0x00F0) >> 4] % h;
+			int n = instruction & 0x000F;
+			bool wide = q.schip && n == 0;
+			int rows = wide ? 16 : n;
+			int size = wide ? 32 : n; // bytes per plane, each selected plane takes the next sprite from I
+			int visible = q.wraps ? rows : std::min(rows, h - y); // rows past the bottom are never read
+			int collisions = 0;
+			word sprite = iReg;
+
+			for (int p = 0; p < planeCount; p++) {
+				if (!(planes & (1 << p))) continue;
+				probe.read(sprite & mask, (word)(visible * (wide ? 2 : 1)));
+				PlaneScreen::Plane& lines = screen.plane(p);
+				for (int row = 0; row < visible; row++) {
+					// sprite row in the top bits, shifted across both words. columns past
+					// the right edge shift out, lores never touches the right word
+					uint64_t bits = wide ? (uint64_t)((mem[(sprite + row * 2) & mask] << 8) | mem[(sprite + row * 2 + 1) & mask]) << 48 : (uint64_t)mem[(sprite + row) & mask] << 56;
+					uint64_t left = (x < 64) ? bits >> x : 0;
+					uint64_t right = (!hires || x == 0) ? 0 : (x < 64) ? bits << (64 - x) : bits >> (x - 64);
+					if constexpr (q.wraps) { // what shifted out on the right comes back on the left
+						if (!hires && x > 0) left |= bits << (64 - x);
+						else if (hires && x > HIRES_WIDTH - 16) left |= bits << (HIRES_WIDTH - x);
+					}
+					int line = q.wraps ? (y + row) % h : y + row;
+					uint64_t* words = lines[line];
+					if ((words[0] & left) | (words[1] & right)) collisions++;
+					uint64_t before = rowHash(p, line);
+					words[0] ^= left;
+					words[1] ^= right;
+					screenHash ^= before ^ rowHash(p, line);
+				}
+				sprite += size;
+			}
+
+			// schip hires counts colliding rows plus rows clipped at the bottom
+			if (q.countsRows && hires) regs[0xF] = (byte)(collisions + rows - visible);
+			else regs[0xF] = collisions ? 1 : 0;
+
+		} break;
+
+		case 0xE000: { // Ex**
+			byte x = (instruction & 0x0F00) >> 8;
+			switch (instruction & 0x00FF) {
+			case 0x9E: // Ex9E: skip next instruction if key with the value of Vx is pressed
+				if (input[regs[x]]) skip<P>();
+				break;
+			case 0xA1: // ExA1: skip next instruction if key with the value of Vx is not pressed
+				if (!input[regs[x]]) skip<P>();
+				break;
+			}
+		} break;
+
+		case 0xF000: { // Fx**
+			byte x = (instruction & 0x0F00) >> 8;
+			switch (instruction & 0x00FF) {
+			case 0x00: // F000 nnnn: set i = nnnn, the address is the next word (xo-chip)
+				if constexpr (q.xochip) {
+					if (x != 0) break;
+					iReg = (mem[pc] << 8) | mem[pc + 1];
+					pc += 2;
+				}
+				break;
+			case 0x01: // Fx01: select the planes in mask x for drawing (xo-chip)
+				if constexpr (q.xochip) planes = x & ALL_PLANES;
+				break;
+			case 0x02: // F002: load the xo-chip audio pattern from memory starting at location i
+				if constexpr (q.xochip) {
+					if (x != 0) break;
+					probe.read(iReg, PATTERN_SIZE);
+					bool changed = !usesPattern;
+					for (int i = 0; i < PATTERN_SIZE; i++) {
+						changed |= pattern[i] != mem[iReg + i];
+						pattern[i] = mem[iReg + i];
+					}
+					usesPattern = true;
+					if (changed) sound(SOUND_VOICE, pitch);
+				}
+				break;
+			case 0x07: // Fx07: set Vx = delay timer value
+				regs[x] = delayReg;
+				break;
+			case 0x0A:  // Fx0A: wait for a key press, store the value of the key in Vx
+				waitReg = x;
+				waiting = true;
+				break;
+			case 0x15: // Fx15: set delay timer = Vx
+				delayReg = regs[x];
+				break;
+			case 0x18: // Fx18: set sound timer = Vx
+				if ((regs[x] > 0) != (soundReg > 0)) sound(SOUND_GATE, regs[x]);
+				soundReg = regs[x];
+				break;
+			case 0x1E: // Fx1E: set i = i + Vx
+				iReg += regs[x];
+				break;
+			case 0x29: // Fx29: set i = location of sprite for digit Vx
+				iReg = SPRITE_ADDRESS + (regs[(instruction & 0x0F00) >> 8] * 5);
+				break;
+			case 0x30: // Fx30: set i = location of the big sprite for digit Vx
+				if constexpr (q.schip) iReg = BIG_SPRITE_ADDRESS + (regs[x] & 0xF) * 10;
+				break;
+			case 0x33: { // Fx33: store BCD representation of Vx in memory locations i, i+1, and i+2
+				byte number = regs[(instruction & 0x0F00) >> 8];
+				probe.write(iReg & mask, 3);
+				mem.write(iReg & mask, number / 100);
+				mem.write((iReg + 1) & mask, (number / 10) % 10);
+				mem.write((iReg + 2) & mask, number % 10);
+			} break;
+			case 0x3A: // Fx3A: set audio pattern pitch = Vx
+				if constexpr (q.xochip) {
+					if (pitch != regs[x]) { pitch = regs[x]; sound(SOUND_VOICE, pitch); }
+				}
+				break;
+			case 0x55: { // Fx55: store registers V0 through Vx in memory starting at location i
+				probe.write(iReg & mask, x + 1);
+				for (int i = 0; i <= x; i++) mem.write((iReg + i) & mask, regs[i]);
+				if constexpr (q.loadStoreStep == 2) iReg += x + 1;
+				else if constexpr (q.loadStoreStep == 1) iReg += x;
+			} break;
+			case 0x65: { // Fx65: read registers V0 through Vx from memory starting at location i
+				probe.read(iReg & mask, x + 1);
+				for (int i = 0; i <= x; i++) regs[i] = mem[(iReg + i) & mask];
+				if constexpr (q.loadStoreStep == 2) iReg += x + 1;
+				else if constexpr (q.loadStoreStep == 1) iReg += x;
+			} break;
+			case 0x75: // Fx75: store V0 through Vx in the rpl flags
+				if constexpr (q.schip) for (int i = 0; i <= x; i++) rpl[i] = regs[i];
+				break;
+			case 0x85: // Fx85: read V0 through Vx from the rpl flags
+				if constexpr (q.schip) for (int i = 0; i <= x; i++) regs[i] = rpl[i];
+				break;
+			}
+		} break;
+		}
+
+		if constexpr (Timed) {
+			int group = instruction >> 12;
+			bool skips = group == 0x3 || group == 0x4 || group == 0x5 || group == 0x9 || group == 0xE;
+			if (skips && pc != next) cost += 4;
+			if ((instruction & 0xF000) == 0xD000) vipBudget = std::min(vipBudget, 0); // display wait, the draw happens after the next interrupt
+			vipBudget -= cost;
+		}
+
+		probe.retire(*this);
+	}
+
+	// 01nn-09nn, only decoded in megachip mode where they aren't 0nnn calls
+	template <class Probe>
+	void megachip(Probe& probe) {
+		byte nn = instruction & 0x00FF;
+		switch (instruction & 0xFF00) {
+		case 0x0100: // 01nn nnnn: set i = nnnnnn. memory is 64KB, so nn has to be 0 to mean the same thing
+			iReg = (mem[pc] << 8) | mem[pc + 1];
+			pc += 2;
+			break;
+		case 0x0200: // 02nn: load nn palette colors from memory starting at location i, 4 bytes ARGB each
+			probe.read(iReg, (word)(nn * 4));
+			mega.loadPalette(mem, iReg, nn);
+			break;
+		case 0x0300: // 03nn: set sprite width = nn
+			spriteWidth = nn;
+			break;
+		case 0x0400: // 04nn: set sprite height = nn
+			spriteHeight = nn;
+			break;
+		case 0x0500: // 05nn: set screen alpha = nn
+			screenAlpha = nn;
+			break;
+		case 0x0600: { // 060n: play the sample at location i, 2 bytes rate, 3 bytes length and a reserved byte before the data
+			probe.read(iReg, 6);
+			unsigned length = (mem[iReg + 2] << 16) | (mem[iReg + 3] << 8) | mem[iReg + 4];
+			sampleRate = (mem[iReg] << 8) | mem[iReg + 1];
+			sampleAddress = (word)(iReg + 6);
+			sampleLength = (word)std::min(length, (unsigned)(MAX_MEM - sampleAddress));
+			sampleLoop = (nn & 0xF) == 0;
+			samplePlaying = true;
+			sound(SOUND_SAMPLE, ++sampleId);
+		} break;
+		case 0x0700: // 0700: stop the sample
+			if (nn != 0) break;
+			samplePlaying = false;
+			sound(SOUND_SAMPLE, ++sampleId);
+			break;
+		case 0x0800: // 080n: set the sprite blend mode
+			blendMode = nn & 0xF;
+			break;
+		case 0x0900: // 09nn: set collision color = nn
+			collisionColor = nn;
+			break;
+		}
+	}
+
+};
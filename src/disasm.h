@@ -0,0 +1,537 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "core.h"
+#include "profiler.h"
+
+/***** disassembler *****/
+
+// one instruction as text, cowgod's mnemonics and mega8's for megachip. operand
+// is the word after it, only F000 nnnn and 01nn nnnn look at it
+inline void disassemble(word instruction, char* out, size_t size, word operand = 0) {
+	int x = (instruction >> 8) & 0xF;
+	int y = (instruction >> 4) & 0xF;
+	int n = instruction & 0xF;
+	int kk = instruction & 0xFF;
+	int nnn = instruction & 0xFFF;
+
+	switch (opcodeClass(instruction)) {
+	case OP_00E0: std::snprintf(out, size, "CLS"); break;
+	case OP_00EE: std::snprintf(out, size, "RET"); break;
+	case OP_0NNN: std::snprintf(out, size, "SYS  0x%03X", nnn); break;
+	case OP_1NNN: std::snprintf(out, size, "JP   0x%03X", nnn); break;
+	case OP_2NNN: std::snprintf(out, size, "CALL 0x%03X", nnn); break;
+	case OP_3XKK: std::snprintf(out, size, "SE   V%X, 0x%02X", x, kk); break;
+	case OP_4XKK: std::snprintf(out, size, "SNE  V%X, 0x%02X", x, kk); break;
+	case OP_5XY0: std::snprintf(out, size, "SE   V%X, V%X", x, y); break;
+	case OP_6XKK: std::snprintf(out, size, "LD   V%X, 0x%02X", x, kk); break;
+	case OP_7XKK: std::snprintf(out, size, "ADD  V%X, 0x%02X", x, kk); break;
+	case OP_8XY0: std::snprintf(out, size, "LD   V%X, V%X", x, y); break;
+	case OP_8XY1: std::snprintf(out, size, "OR   V%X, V%X", x, y); break;
+	case OP_8XY2: std::snprintf(out, size, "AND  V%X, V%X", x, y); break;
+	case OP_8XY3: std::snprintf(out, size, "XOR  V%X, V%X", x, y); break;
+	case OP_8XY4: std::snprintf(out, size, "ADD  V%X, V%X", x, y); break;
+	case OP_8XY5: std::snprintf(out, size, "SUB  V%X, V%X", x, y); break;
+	case OP_8XY6: std::snprintf(out, size, "SHR  V%X, V%X", x, y); break;
+	case OP_8XY7: std::snprintf(out, size, "SUBN V%X, V%X", x, y); break;
+	case OP_8XYE: std::snprintf(out, size, "SHL  V%X, V%X", x, y); break;
+	case OP_9XY0: std::snprintf(out, size, "SNE  V%X, V%X", x, y); break;
+	case OP_ANNN: std::snprintf(out, size, "LD   I, 0x%03X", nnn); break;
+	case OP_BNNN: std::snprintf(out, size, "JP   V0, 0x%03X", nnn); break;
+	case OP_CXKK: std::snprintf(out, size, "RND  V%X, 0x%02X", x, kk); break;
+	case OP_DXYN: std::snprintf(out, size, "DRW  V%X, V%X, %d", x, y, n); break;
+	case OP_EX9E: std::snprintf(out, size, "SKP  V%X", x); break;
+	case OP_EXA1: std::snprintf(out, size, "SKNP V%X", x); break;
+	case OP_FX07: std::snprintf(out, size, "LD   V%X, DT", x); break;
+	case OP_FX0A: std::snprintf(out, size, "LD   V%X, K", x); break;
+	case OP_FX15: std::snprintf(out, size, "LD   DT, V%X", x); break;
+	case OP_FX18: std::snprintf(out, size, "LD   ST, V%X", x); break;
+	case OP_FX1E: std::snprintf(out, size, "ADD  I, V%X", x); break;
+	case OP_FX29: std::snprintf(out, size, "LD   F, V%X", x); break;
+	case OP_FX33: std::snprintf(out, size, "LD   B, V%X", x); break;
+	case OP_FX55: std::snprintf(out, size, "LD   [I], V%X", x); break;
+	case OP_FX65: std::snprintf(out, size, "LD   V%X, [I]", x); break;
+	case OP_F002: std::snprintf(out, size, "LD   AUDIO, [I]"); break;
+	case OP_FX3A: std::snprintf(out, size, "LD   PITCH, V%X", x); break;
+	case OP_00CN: std::snprintf(out, size, "SCD  %d", n); break;
+	case OP_00FB: std::snprintf(out, size, "SCR"); break;
+	case OP_00FC: std::snprintf(out, size, "SCL"); break;
+	case OP_00FD: std::snprintf(out, size, "EXIT"); break;
+	case OP_00FE: std::snprintf(out, size, "LOW"); break;
+	case OP_00FF: std::snprintf(out, size, "HIGH"); break;
+	case OP_FX30: std::snprintf(out, size, "LD   HF, V%X", x); break;
+	case OP_FX75: std::snprintf(out, size, "LD   R, V%X", x); break;
+	case OP_FX85: std::snprintf(out, size, "LD   V%X, R", x); break;
+	case OP_00DN: std::snprintf(out, size, "SCU  %d", n); break;
+	case OP_5XY2: std::snprintf(out, size, "LD   [I], V%X-V%X", x, y); break;
+	case OP_5XY3: std::snprintf(out, size, "LD   V%X-V%X, [I]", x, y); break;
+	case OP_F000: std::snprintf(out, size, "LD   I, 0x%04X", operand); break;
+	case OP_FX01: std::snprintf(out, size, "PLN  %d", x); break;
+	case OP_0010: std::snprintf(out, size, "MEGAOFF"); break;
+	case OP_0011: std::snprintf(out, size, "MEGAON"); break;
+	case OP_00BN: std::snprintf(out, size, "SCRU %d", n); break;
+	case OP_01NN: std::snprintf(out, size, "LDHI I, 0x%06X", (kk << 16) | operand); break;
+	case OP_02NN: std::snprintf(out, size, "LDPAL %d", kk); break;
+	case OP_03NN: std::snprintf(out, size, "SPRW %d", kk); break;
+	case OP_04NN: std::snprintf(out, size, "SPRH %d", kk); break;
+	case OP_05NN: std::snprintf(out, size, "ALPHA %d", kk); break;
+	case OP_060N: std::snprintf(out, size, "DIGISND %d", n); break;
+	case OP_0700: std::snprintf(out, size, "STOPSND"); break;
+	case OP_080N: std::snprintf(out, size, "BMODE %d", n); break;
+	case OP_09NN: std::snprintf(out, size, "CCOL %d", kk); break;
+	default: std::snprintf(out, size, "DW   0x%04X", instruction); break;
+	}
+}
+
+
+
+/***** control flow *****/
+
+// recursive descent over guest memory from START_ADDRESS, following jumps,
+// calls and both sides of every skip, so bytes are only called code when some
+// path actually reaches them. I is tracked as a constant along each path, an
+// Annn or F000 followed by Dxyn marks the sprite rows it draws, Fx55/Fx65 and
+// 5xy2/5xy3 mark the tables they touch. nothing here knows about the frontend, anything that
+// wants the cfg (a recompiler, idle loop detection) can run its own copy and
+// feed it writes through the probe hook.
+class ControlFlow : public NoProbe {
+public:
+	enum Flag : byte {
+		CODE = 1 << 0, // first byte of a reachable instruction
+		OPERAND = 1 << 1, // any later byte of one
+		SPRITE = 1 << 2, // drawn by Dxyn with a known I
+		DATA = 1 << 3, // read or written by Fx55/Fx65 with a known I
+		ENTRY = 1 << 4, // START_ADDRESS, a call target or a pc seen at runtime
+		TARGET = 1 << 5, // jump or branch target, starts a block
+	};
+
+	enum Exit : byte {
+		FALL, // runs into the next block
+		JUMP, // 1nnn
+		CALL, // 2nnn, next[0] is the callee, next[1] the return address
+		RETURN, // 00EE
+		BRANCH, // skips, next[0] is the next instruction, next[1] the one after
+		INDIRECT, // Bnnn, targets only known at runtime
+		STOP, // undecodable or runs off the end of memory
+	};
+
+	// straight line run of instructions [start, end)
+	struct Block {
+		word start;
+		word end;
+		Exit exit;
+		byte nextCount;
+		word next[2];
+	};
+
+	void reset() {
+		std::memset(flags, 0, sizeof(flags));
+		blockIndex.assign(MAX_MEM, -1);
+		blockList.clear();
+		entries.clear();
+		romEnd = START_ADDRESS;
+		stale = true;
+	}
+
+	// rebuilds everything from memory, a few microseconds for a full rom
+	void analyze(const Memory& mem, word romSize) {
+		if (blockIndex.empty()) reset();
+		romEnd = (word)(START_ADDRESS + romSize);
+		std::memset(flags, 0, sizeof(flags));
+
+		std::vector<Path> work;
+		work.push_back({ START_ADDRESS, false, 0 });
+		for (word entry : entries) work.push_back({ entry, false, 0 });
+		flags[START_ADDRESS] |= ENTRY;
+		for (word entry : entries) flags[entry] |= ENTRY;
+
+		while (!work.empty()) {
+			Path path = work.back();
+			work.pop_back();
+			trace(mem, path, work);
+		}
+
+		buildBlocks(mem);
+		stale = false;
+		generation++;
+	}
+
+	// a write to any byte of a decoded instruction means the cfg is out of date,
+	// writes to sprites, tables and untouched bytes leave it alone
+	void invalidate(word address, word count) {
+		for (word i = 0; i < count; i++) {
+			if (flags[(address + i) & (MAX_MEM - 1)] & (CODE | OPERAND)) { stale = true; return; }
+		}
+	}
+
+	void write(word address, word count) {
+		invalidate(address, count);
+	}
+
+	// code only reachable through Bnnn or written at runtime, found when the pc lands there
+	void addEntry(word address) {
+		address &= MAX_MEM - 1;
+		if ((flags[address] & CODE) || address >= MAX_MEM - 1) return;
+		entries.push_back(address);
+		stale = true;
+	}
+
+	bool needsUpdate() const { return stale; }
+	uint64_t version() const { return generation; } // bumped by every analyze()
+	word end() const { return romEnd; }
+
+	byte at(word address) const { return flags[address & (MAX_MEM - 1)]; }
+	bool isCode(word address) const { return at(address) & CODE; }
+
+	const std::vector<Block>& blocks() const { return blockList; }
+
+	// block holding the instruction at address, or null for anything that isn't code
+	const Block* blockAt(word address) const {
+		address &= MAX_MEM - 1;
+		if (blockIndex.empty() || blockIndex[address] < 0) return nullptr;
+		return &blockList[blockIndex[address]];
+	}
+
+private:
+	struct Path {
+		word pc;
+		bool iKnown;
+		word i;
+	};
+
+	// where a taken skip lands: past the instruction after the skip, all four bytes of it for an F000 or 01nn
+	static word skipTarget(const Memory& mem, word next) {
+		return (word)(next + instructionSize((word)((mem[next] << 8) | mem[next + 1])));
+	}
+
+	// follows one path until it ends or meets code already visited
+	void trace(const Memory& mem, Path path, std::vector<Path>& work) {
+		word pc = path.pc;
+		while (pc < MAX_MEM - 1 && !(flags[pc] & CODE)) {
+			flags[pc] |= CODE;
+			flags[pc + 1] |= OPERAND;
+			word instruction = (mem[pc] << 8) | mem[pc + 1];
+			word nnn = instruction & 0x0FFF;
+			word next = pc + 2;
+			int x = (instruction >> 8) & 0xF;
+			int y = (instruction >> 4) & 0xF;
+
+			switch (opcodeClass(instruction)) {
+			case OP_00EE:
+			case OP_00FD:
+			case OP_UNKNOWN:
+			case OP_BNNN:
+				return;
+			case OP_1NNN:
+				flags[nnn] |= TARGET;
+				next = nnn;
+				break;
+			case OP_2NNN:
+				// the callee may leave anything in I
+				flags[nnn] |= ENTRY;
+				work.push_back({ nnn, path.iKnown, path.i });
+				path.iKnown = false;
+				break;
+			case OP_3XKK: case OP_4XKK: case OP_5XY0: case OP_9XY0: case OP_EX9E: case OP_EXA1: {
+				word target = skipTarget(mem, next);
+				flags[target & (MAX_MEM - 1)] |= TARGET;
+				work.push_back({ target, path.iKnown, path.i });
+			} break;
+			case OP_ANNN:
+				path.iKnown = true;
+				path.i = nnn;
+				break;
+			case OP_F000:
+			case OP_01NN:
+				mark(next, 2, OPERAND);
+				path.iKnown = true;
+				path.i = (mem[next] << 8) | mem[next + 1];
+				next += 2;
+				break;
+			case OP_02NN:
+				if (path.iKnown) mark(path.i, (word)((instruction & 0xFF) * 4), DATA);
+				break;
+			case OP_5XY2:
+			case OP_5XY3:
+				if (path.iKnown) mark(path.i, (word)((x < y ? y - x : x - y) + 1), DATA);
+				break;
+			case OP_DXYN:
+				if (path.iKnown) mark(path.i, (instruction & 0xF) ? (instruction & 0xF) : 32, SPRITE); // Dxy0 is 16x16
+				break;
+			case OP_FX55:
+			case OP_FX65:
+				if (path.iKnown) {
+					word count = x + 1;
+					mark(path.i, count, DATA);
+					path.i += count;
+				}
+				break;
+			case OP_F002:
+				if (path.iKnown) mark(path.i, PATTERN_SIZE, DATA);
+				break;
+			case OP_FX1E:
+			case OP_FX29:
+			case OP_FX30:
+				path.iKnown = false;
+				break;
+			default:
+				break;
+			}
+			pc = next & (MAX_MEM - 1);
+		}
+	}
+
+	void mark(word address, word count, Flag flag) {
+		for (word i = 0; i < count; i++) flags[(address + i) & (MAX_MEM - 1)] |= flag;
+	}
+
+	// blocks start at entries, targets and after anything that leaves the straight line
+	void buildBlocks(const Memory& mem) {
+		blockList.clear();
+		blockIndex.assign(MAX_MEM, -1);
+
+		for (int pc = 0; pc < MAX_MEM - 1; ) {
+			if (!(flags[pc] & CODE)) { pc++; continue; }
+
+			Block block{ (word)pc, (word)pc, FALL, 0, { 0, 0 } };
+			int index = (int)blockList.size();
+			while (pc < MAX_MEM - 1 && (flags[pc] & CODE)) {
+				if (pc != block.start && (flags[pc] & (ENTRY | TARGET))) break;
+				blockIndex[pc] = index;
+				word instruction = (mem[pc] << 8) | mem[pc + 1];
+				pc += instructionSize(instruction);
+				block.exit = exitOf(mem, instruction, (word)pc, block);
+				if (block.exit != FALL) break;
+			}
+			block.end = (word)pc;
+			if (block.exit == FALL) {
+				if (pc < MAX_MEM - 1 && (flags[pc] & CODE)) block.next[block.nextCount++] = (word)pc;
+				else block.exit = STOP;
+			}
+			blockList.push_back(block);
+		}
+	}
+
+	static Exit exitOf(const Memory& mem, word instruction, word next, Block& block) {
+		word nnn = instruction & 0x0FFF;
+		switch (opcodeClass(instruction)) {
+		case OP_1NNN:
+			block.next[block.nextCount++] = nnn;
+			return JUMP;
+		case OP_2NNN:
+			block.next[block.nextCount++] = nnn;
+			block.next[block.nextCount++] = next;
+			return CALL;
+		case OP_00EE:
+			return RETURN;
+		case OP_BNNN:
+			return INDIRECT;
+		case OP_00FD:
+		case OP_UNKNOWN:
+			return STOP;
+		case OP_3XKK: case OP_4XKK: case OP_5XY0: case OP_9XY0: case OP_EX9E: case OP_EXA1:
+			block.next[block.nextCount++] = next;
+			block.next[block.nextCount++] = skipTarget(mem, next);
+			return BRANCH;
+		default:
+			return FALL;
+		}
+	}
+
+	byte flags[MAX_MEM]{};
+	std::vector<int> blockIndex; // block per code byte, -1 elsewhere
+	std::vector<Block> blockList;
+	std::vector<word> entries; // found at runtime, kept until reset()
+	word romEnd = START_ADDRESS;
+	bool stale = true;
+	uint64_t generation = 0;
+};
+
+
+
+/***** platform detection *****/
+
+// for roms whose extension doesn't say which platform they're for: the first
+// one whose instruction set covers all the code reachable from the entry point.
+// sprite bytes that happen to read as 00FF don't count, only instructions some
+// path actually runs into.
+inline Platform detectPlatform(const c8ke& emu) {
+	ControlFlow cfg;
+	cfg.analyze(emu.mem, emu.romSize);
+	Platform platform = (START_ADDRESS + emu.romSize > QUIRKS[SCHIP].memory) ? XOCHIP : CHIP8; // only xo-chip has room
+	for (const ControlFlow::Block& block : cfg.blocks()) {
+		for (int pc = block.start; pc < block.end; ) {
+			word instruction = (emu.mem[pc] << 8) | emu.mem[pc + 1];
+			switch (opcodeClass(instruction)) {
+			case OP_0011:
+				return MEGACHIP;
+			case OP_00DN: case OP_5XY2: case OP_5XY3: case OP_F000: case OP_FX01: case OP_F002: case OP_FX3A:
+				platform = XOCHIP;
+				break;
+			case OP_00CN: case OP_00FB: case OP_00FC: case OP_00FD: case OP_00FE: case OP_00FF: case OP_FX30: case OP_FX75: case OP_FX85:
+				if (platform < SCHIP) platform = SCHIP;
+				break;
+			case OP_DXYN:
+				if ((instruction & 0xF) == 0 && platform < SCHIP) platform = SCHIP; // 16x16
+				break;
+			default:
+				break;
+			}
+			pc += instructionSize(instruction);
+		}
+	}
+	return platform;
+}
+
+
+
+/***** disassembly view *****/
+
+// what the debugger panel shows: the cfg laid out as rows, with the text of
+// each row formatted the first time it's visible and kept until memory under
+// it changes. update() diffs guest memory against the last copy it saw, so it
+// catches writes whether or not the instrumented core was running, and only
+// the changed ranges lose their text.
+class Disassembly {
+public:
+	enum RowKind : byte { LABEL, INSTRUCTION, SPRITE_ROW, DATA_ROW, UNKNOWN_ROW };
+
+	struct Row {
+		word address;
+		byte length;
+		RowKind kind;
+	};
+
+	static const int TEXT_SIZE = 32;
+	static const int UNKNOWN_PER_ROW = 4; // bytes nothing reaches, grouped to keep the list short
+
+	void reset() {
+		cfg.reset();
+		rows.clear();
+		std::memset(image, 0, sizeof(image));
+		std::memset(cached, 0, sizeof(cached));
+		romSize = 0;
+		seen = UINT64_MAX;
+	}
+
+	// once per frame while the panel is open
+	void update(const c8ke& emu) {
+		if (emu.romSize != romSize) {
+			reset();
+			romSize = emu.romSize;
+		}
+
+		byte current[MAX_MEM];
+		emu.mem.copyTo(current);
+		for (int a = 0; a < MAX_MEM; ) {
+			if (current[a] == image[a]) { a++; continue; }
+			int start = a;
+			while (a < MAX_MEM && current[a] != image[a]) a++;
+			std::memcpy(image + start, current + start, a - start);
+			cfg.invalidate((word)start, (word)(a - start));
+			for (int i = (start > 0 ? start - 1 : 0); i < a; i++) { // an instruction may start one byte before
+				cached[i] = false;
+				if (rowIndex[i] >= 0) cached[rows[rowIndex[i]].address] = false;
+			}
+		}
+		if (!romSize) return;
+
+		if (cfg.needsUpdate()) cfg.analyze(emu.mem, romSize);
+		if (!emu.waiting) cfg.addEntry(emu.pc);
+		if (cfg.needsUpdate()) cfg.analyze(emu.mem, romSize);
+		if (cfg.version() != seen) buildRows();
+	}
+
+	const ControlFlow& flow() const { return cfg; }
+	const std::vector<Row>& list() const { return rows; }
+
+	// row holding address, for following the pc
+	int rowOf(word address) const {
+		address &= MAX_MEM - 1;
+		return rowIndex[address];
+	}
+
+	const char* text(int row) {
+		const Row& r = rows[row];
+		if (r.kind == LABEL) {
+			std::snprintf(label, sizeof(label), "sub_%03X:", r.address);
+			return label;
+		}
+		if (cached[r.address]) return lines[r.address];
+
+		char* out = lines[r.address];
+		switch (r.kind) {
+		case INSTRUCTION:
+			disassemble(wordAt(r.address), out, TEXT_SIZE, wordAt(r.address + 2));
+			break;
+		case SPRITE_ROW: {
+			// the row as it looks on screen
+			char bits[9];
+			for (int b = 0; b < 8; b++) bits[b] = (image[r.address] >> (7 - b)) & 1 ? '#' : '.';
+			bits[8] = '\0';
+			std::snprintf(out, TEXT_SIZE, "DB   0x%02X  %s", image[r.address], bits);
+		} break;
+		default: {
+			int length = std::snprintf(out, TEXT_SIZE, "DB  ");
+			for (int i = 0; i < r.length; i++) length += std::snprintf(out + length, TEXT_SIZE - length, " %02X", image[r.address + i]);
+		} break;
+		}
+		cached[r.address] = true;
+		return out;
+	}
+
+private:
+	void buildRows() {
+		rows.clear();
+		rowIndex.assign(MAX_MEM, -1);
+		std::memset(cached, 0, sizeof(cached));
+
+		// the rom plus any code that runs outside it
+		int end = cfg.end();
+		for (int a = end; a < MAX_MEM; a++) if (cfg.at((word)a) & (CODE_BYTES)) end = a + 1;
+
+		for (int a = START_ADDRESS; a < end; ) {
+			byte f = cfg.at((word)a);
+			int index = (int)rows.size();
+			if (f & ControlFlow::CODE) {
+				if ((f & ControlFlow::ENTRY) && a != START_ADDRESS) rows.push_back({ (word)a, 0, LABEL });
+				int length = instructionSize(wordAt(a));
+				rows.push_back({ (word)a, (byte)length, INSTRUCTION });
+				for (int i = 0; i < length && a + i < MAX_MEM; i++) rowIndex[a + i] = (int)rows.size() - 1;
+				a += length;
+			} else if (f & (ControlFlow::SPRITE | ControlFlow::DATA)) {
+				rows.push_back({ (word)a, 1, (f & ControlFlow::SPRITE) ? SPRITE_ROW : DATA_ROW });
+				rowIndex[a] = index;
+				a++;
+			} else {
+				int length = 0;
+				while (length < UNKNOWN_PER_ROW && a + length < end && !(cfg.at((word)(a + length)) & (CODE_BYTES | ControlFlow::SPRITE | ControlFlow::DATA))) length++;
+				if (length == 0) length = 1; // operand of an instruction that starts off the row grid
+				rows.push_back({ (word)a, (byte)length, UNKNOWN_ROW });
+				for (int i = 0; i < length; i++) rowIndex[a + i] = index;
+				a += length;
+			}
+		}
+		seen = cfg.version();
+	}
+
+	word wordAt(int address) const {
+		return (word)((image[address & (MAX_MEM - 1)] << 8) | image[(address + 1) & (MAX_MEM - 1)]);
+	}
+
+	static const byte CODE_BYTES = ControlFlow::CODE | ControlFlow::OPERAND;
+
+	ControlFlow cfg;
+	std::vector<Row> rows;
+	std::vector<int> rowIndex = std::vector<int>(MAX_MEM, -1);
+	byte image[MAX_MEM]{}; // memory as of the last update()
+	bool cached[MAX_MEM]{}; // lines[a] is current
+	char lines[MAX_MEM][TEXT_SIZE]{};
+	char label[TEXT_SIZE]{};
+	word romSize = 0;
+	uint64_t seen = UINT64_MAX; // cfg version the rows were built from
+};
@@ -0,0 +1,229 @@
+#include <algorithm>
+
+#include "env.h"
+#include "search.h"
+
+
+
+/***** helper functions *****/
+
+static uint64_t splitmix(uint64_t& state) {
+	uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+
+
+/***** environment *****/
+
+Env::Env(const std::vector<byte>& rom, const c8ke_env_config& config) : rom(rom), config(config) {
+	platform = choosePlatform("", rom, config.platform);
+	if (this->config.num_envs < 1) this->config.num_envs = 1;
+	if (this->config.frame_skip < 1) this->config.frame_skip = 1;
+	slots.resize(this->config.num_envs);
+
+	int threads = this->config.threads > 0 ? this->config.threads : (int)std::thread::hardware_concurrency();
+	pool = std::make_unique<ThreadPool>(std::min(threads, this->config.num_envs));
+
+	for (int i = 0; i < size(); i++) resetSlot(slots[i], (uint64_t)i);
+}
+
+Platform Env::choosePlatform(const char* path, const std::vector<byte>& rom, int requested) {
+	if (requested >= 0 && requested < PLATFORMS) return (Platform)requested;
+	Platform platform = c8ke::platformFor(path);
+	if (platform != AUTO) return platform;
+
+	c8ke probe;
+	probe.reset();
+	probe.load(rom.data(), rom.size());
+	return detectPlatform(probe);
+}
+
+const byte* Env::memory(int index) {
+	slots[index].emu.mem.copyTo(slots[index].memView, 0, slots[index].emu.memorySize());
+	return slots[index].memView;
+}
+
+void Env::setHooks(c8ke_reward_fn reward, c8ke_done_fn done, void* user) {
+	rewardHook = reward;
+	doneHook = done;
+	hookUser = user;
+}
+
+void Env::resetSlot(Slot& slot, uint64_t seed) {
+	slot.emu.reset(seed, platform);
+	slot.emu.load(rom.data(), rom.size());
+	slot.action = 0;
+	slot.frames = 0;
+	slot.seed = seed;
+	slot.stickyState = seed ^ 0x5DEECE66Dull;
+	slot.lastScore = (config.reward_addr >= 0) ? slot.emu.mem[config.reward_addr & (MAX_MEM - 1)] : 0;
+}
+
+void Env::writeObs(const c8ke& emu, byte* out) const {
+	for (int y = 0; y < HEIGHT; y++) {
+		uint64_t row = emu.loresRow(y);
+		if (config.packed) {
+			for (int b = 0; b < WIDTH / 8; b++) *out++ = (byte)(row >> (WIDTH - 8 - b * 8));
+		} else {
+			for (int x = 0; x < WIDTH; x++) *out++ = (byte)((row >> (WIDTH - 1 - x)) & 1);
+		}
+	}
+}
+
+void Env::reset(const uint64_t* seeds, byte* obs) {
+	pool->parallelFor(size(), [&](int i) {
+		resetSlot(slots[i], seeds ? seeds[i] : (uint64_t)i);
+		if (obs) writeObs(slots[i].emu, obs + i * obsSize());
+	});
+}
+
+void Env::stepRange(int first, int last, const uint16_t* actions, byte* obs, float* rewards, byte* dones) {
+	for (int i = first; i < last; i++) {
+		Slot& slot = slots[i];
+		const c8ke& emu = slot.emu;
+
+		for (int f = 0; f < config.frame_skip; f++) {
+			bool sticky = config.sticky_prob > 0.0f && (splitmix(slot.stickyState) >> 40) < (uint64_t)(config.sticky_prob * (1 << 24));
+			if (!sticky) slot.action = actions[i];
+			slot.emu.frame(slot.action);
+			slot.frames++;
+		}
+
+		// hooks get a flat copy since the core keeps memory in pages, only as much as the platform has
+		if (rewardHook || doneHook) emu.mem.copyTo(slot.memView, 0, emu.memorySize());
+
+		float reward = 0.0f;
+		if (rewardHook) {
+			reward = rewardHook(i, slot.memView, emu.regs, hookUser);
+		} else if (config.reward_addr >= 0) {
+			byte score = emu.mem[config.reward_addr & (MAX_MEM - 1)];
+			reward = (float)(signed char)(score - slot.lastScore);
+			slot.lastScore = score;
+		}
+
+		bool done = false;
+		if (doneHook) done = doneHook(i, slot.memView, emu.regs, hookUser) != 0;
+		else if (config.done_addr >= 0) done = emu.mem[config.done_addr & (MAX_MEM - 1)] == (byte)config.done_value;
+		if (config.max_frames > 0 && slot.frames >= config.max_frames) done = true;
+
+		// gym style auto reset, the next episode gets a seed derived from this one
+		if (done) {
+			uint64_t state = slot.seed;
+			resetSlot(slot, splitmix(state));
+		}
+
+		if (rewards) rewards[i] = reward;
+		if (dones) dones[i] = done ? 1 : 0;
+		if (obs) writeObs(emu, obs + i * obsSize());
+	}
+}
+
+void Env::step(const uint16_t* actions, byte* obs, float* rewards, byte* dones) {
+	// a few blocks per worker keeps the load balanced without one atomic per instance
+	int blocks = std::min(size(), pool->size() * 4);
+	int perBlock = (size() + blocks - 1) / blocks;
+	pool->parallelFor(blocks, [&](int b) {
+		int first = b * perBlock;
+		int last = std::min(size(), first + perBlock);
+		stepRange(first, last, actions, obs, rewards, dones);
+	});
+}
+
+
+
+/***** C interface *****/
+
+struct c8ke_env {
+	Env env;
+	c8ke_env(const std::vector<byte>& rom, const c8ke_env_config& config) : env(rom, config) {}
+};
+
+void c8ke_env_default_config(c8ke_env_config* config) {
+	config->num_envs = 1;
+	config->frame_skip = 1;
+	config->sticky_prob = 0.0f;
+	config->packed = 0;
+	config->threads = 0;
+	config->max_frames = 0;
+	config->reward_addr = -1;
+	config->done_addr = -1;
+	config->done_value = 0;
+	config->platform = -1;
+}
+
+c8ke_env* c8ke_env_create(const char* rom_path, const c8ke_env_config* config) {
+	std::vector<byte> rom;
+	if (rom_path == nullptr || !c8ke::readRom(rom_path, rom)) return nullptr;
+
+	c8ke_env_config defaults;
+	c8ke_env_default_config(&defaults);
+	c8ke_env_config chosen = config ? *config : defaults;
+	chosen.platform = Env::choosePlatform(rom_path, rom, chosen.platform);
+	return new c8ke_env(rom, chosen);
+}
+
+void c8ke_env_destroy(c8ke_env* env) {
+	delete env;
+}
+
+int c8ke_env_num_envs(const c8ke_env* env) {
+	return env->env.size();
+}
+
+size_t c8ke_env_obs_size(const c8ke_env* env) {
+	return env->env.obsSize();
+}
+
+void c8ke_env_set_hooks(c8ke_env* env, c8ke_reward_fn reward, c8ke_done_fn done, void* user) {
+	env->env.setHooks(reward, done, user);
+}
+
+void c8ke_env_reset(c8ke_env* env, const uint64_t* seeds, uint8_t* obs) {
+	env->env.reset(seeds, obs);
+}
+
+void c8ke_env_step(c8ke_env* env, const uint16_t* actions, uint8_t* obs, float* rewards, uint8_t* dones) {
+	env->env.step(actions, obs, rewards, dones);
+}
+
+const uint8_t* c8ke_env_memory(c8ke_env* env, int index) {
+	if (index < 0 || index >= env->env.size()) return nullptr;
+	return env->env.memory(index);
+}
+
+void c8ke_search_default_config(c8ke_search_config* config) {
+	SearchConfig defaults;
+	config->frames_per_input = defaults.framesPerInput;
+	config->max_depth = defaults.maxDepth;
+	config->max_frontier = (int)defaults.maxFrontier;
+	config->threads = defaults.threads;
+	config->goal_addr = 0;
+	config->goal_value = 0;
+}
+
+int c8ke_search(const char* rom_path, uint64_t seed, const c8ke_search_config* config, uint16_t* inputs, int max_inputs) {
+	std::vector<byte> rom;
+	if (rom_path == nullptr || config == nullptr || !c8ke::readRom(rom_path, rom)) return -1;
+
+	c8ke start;
+	start.reset(seed, Env::choosePlatform(rom_path, rom, -1));
+	start.load(rom.data(), rom.size());
+
+	SearchConfig search;
+	search.framesPerInput = config->frames_per_input;
+	search.maxDepth = config->max_depth;
+	search.maxFrontier = (size_t)std::max(1, config->max_frontier);
+	search.threads = config->threads;
+
+	const unsigned addr = (unsigned)config->goal_addr;
+	const int value = config->goal_value;
+	SearchResult result = searchInputs(start, search, [&](const c8ke& emu) { return emu.mem[addr] >= value; });
+	if (!result.found) return -1;
+
+	int total = std::min((int)result.inputs.size(), max_inputs);
+	if (inputs) std::copy(result.inputs.begin(), result.inputs.begin() + total, inputs);
+	return (int)result.inputs.size();
+}
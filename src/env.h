@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "core.h"
+#include "disasm.h"
+#include "pool.h"
+#include "c8ke_env.h"
+
+// observation sizes per instance
+const size_t OBS_SIZE = WIDTH * HEIGHT; // 1 byte per pixel
+const size_t OBS_SIZE_PACKED = WIDTH * HEIGHT / 8; // 1 bit per pixel, 8 bytes per row
+
+/***** vectorized environment *****/
+
+// N headless c8ke instances stepped in lockstep, for reinforcement learning.
+// all emulation (frame skip, sticky actions, rewards, auto reset) happens in
+// here so the trainer only crosses the api once per batch.
+class Env {
+public:
+	Env(const std::vector<byte>& rom, const c8ke_env_config& config);
+
+	// config.platform if it names one, else the extension, else the code
+	static Platform choosePlatform(const char* path, const std::vector<byte>& rom, int requested);
+
+	int size() const { return (int)slots.size(); }
+	size_t obsSize() const { return config.packed ? OBS_SIZE_PACKED : OBS_SIZE; }
+	const c8ke& instance(int index) const { return slots[index].emu; }
+	const byte* memory(int index); // flat snapshot of an instance's memory
+
+	void setHooks(c8ke_reward_fn reward, c8ke_done_fn done, void* user);
+
+	void reset(const uint64_t* seeds, byte* obs);
+	void step(const uint16_t* actions, byte* obs, float* rewards, byte* dones);
+
+private:
+	struct Slot {
+		c8ke emu;
+		uint16_t action = 0; // action currently applied, differs from the requested one while sticky
+		int frames = 0; // frames since the episode started
+		byte lastScore = 0; // mem[reward_addr] at the end of the previous step
+		uint64_t seed = 0; // seed of the current episode
+		uint64_t stickyState = 0; // separate from the guest rng so sticky actions don't change the game
+		byte memView[MAX_MEM]{}; // flat copy of memory handed to hooks
+	};
+
+	void resetSlot(Slot& slot, uint64_t seed);
+	void writeObs(const c8ke& emu, byte* out) const;
+	void stepRange(int first, int last, const uint16_t* actions, byte* obs, float* rewards, byte* dones);
+
+	std::vector<byte> rom;
+	c8ke_env_config config;
+	Platform platform; // from config.platform, or picked once from the rom
+	std::vector<Slot> slots;
+	std::unique_ptr<ThreadPool> pool;
+
+	c8ke_reward_fn rewardHook = nullptr;
+	c8ke_done_fn doneHook = nullptr;
+	void* hookUser = nullptr;
+};
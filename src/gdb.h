@@ -0,0 +1,480 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#if defined(_WIN32)
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#ifndef NOMINMAX
+		#define NOMINMAX // std::min and std::max are used all over
+	#endif
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+	#pragma comment(lib, "Ws2_32.lib")
+	using Socket = SOCKET;
+	const Socket NO_SOCKET = INVALID_SOCKET;
+#else
+	#include <arpa/inet.h>
+	#include <netinet/in.h>
+	#include <netinet/tcp.h>
+	#include <sys/select.h>
+	#include <sys/socket.h>
+	#include <unistd.h>
+	using Socket = int;
+	const Socket NO_SOCKET = -1;
+#endif
+
+#include "core.h"
+#include "breakpoints.h"
+
+/***** gdb remote stub *****/
+
+// gdb remote serial protocol on 127.0.0.1, one client at a time. the socket
+// lives on its own thread, which sleeps in accept()/recv() while nobody is
+// talking, and anything that touches the machine is handed to the emulation
+// thread through a one slot mailbox that service() checks with a single
+// atomic load per main loop pass.
+//
+// registers, in 'g' order and little endian:
+//   0-15 V0-VF (8 bit)  16 I (16)  17 PC (16)  18 SP (8)  19 DT (8)  20 ST (8)
+// breakpoints go into the frontend's Breakpoints: Z0/Z1 exec, Z2 write,
+// Z3 read, Z4 both, so they show up in the debugger window too.
+class GdbServer {
+public:
+	// what the frontend should do after service(), or'd together
+	enum Action { NONE = 0, HALT = 1, RESUME = 2, STEP = 4, MODIFIED = 8 };
+
+	static const int REGISTERS = 21;
+	static const unsigned long PACKET_SIZE = 0x1000; // advertised in qSupported, in hex there
+
+	~GdbServer() { stop(); }
+
+	bool start(uint16_t port) {
+#if defined(_WIN32)
+		WSADATA data;
+		if (WSAStartup(MAKEWORD(2, 2), &data) != 0) return false;
+#endif
+		listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (listener == NO_SOCKET) return false;
+
+		int on = 1;
+		setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(port);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // never reachable from other machines
+		if (bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 1) != 0) {
+			closeSocket(listener);
+			return false;
+		}
+
+		stopping = false;
+		server = std::thread([this] { serve(); });
+		return true;
+	}
+
+	void stop() {
+		if (!server.joinable()) return;
+		stopping = true;
+		shutdownSocket(client); // wakes recv(), the accept loop polls stopping
+		replied.notify_all();
+		server.join();
+		closeSocket(listener);
+#if defined(_WIN32)
+		WSACleanup();
+#endif
+	}
+
+	bool active() const { return server.joinable(); }
+	bool attached() const { return client != NO_SOCKET; }
+
+	// emulation thread side, runs the pending request against the machine.
+	// stopped is whether the frontend is currently in its break state.
+	int service(c8ke& emu, Breakpoints& breakpoints, bool stopped) {
+		if (!waiting.load(std::memory_order_acquire)) return NONE;
+		std::lock_guard<std::mutex> lock(mutex);
+
+		// a continue or step is only answered once the machine stops
+		if (running) {
+			if (!stopped) {
+				if (!interrupt.exchange(false)) return NONE;
+				signal = 2; // SIGINT, the client pressed ctrl-c
+				return HALT;
+			}
+			char stop[4];
+			std::snprintf(stop, sizeof(stop), "S%02X", signal);
+			running = false;
+			answer(stop);
+			return NONE;
+		}
+		if (!pending) return NONE;
+		pending = false;
+
+		int action = NONE;
+		std::string reply = execute(request, emu, breakpoints, stopped, action);
+		if (running) return action;
+		answer(reply);
+		return action;
+	}
+
+private:
+	// commands that read or change the machine, everything else is answered on the server thread
+	static bool needsMachine(char command) {
+		return std::strchr("?gGpPmMZzscDk", command) != nullptr;
+	}
+
+	std::string execute(const std::string& packet, c8ke& emu, Breakpoints& breakpoints, bool stopped, int& action) {
+		const char* args = packet.c_str() + 1;
+		switch (packet[0]) {
+		case '?': // first thing a client asks, stop the machine so it sees a stable state
+			if (!stopped) action |= HALT;
+			return "S05";
+
+		case 'g': {
+			std::string out;
+			for (int r = 0; r < REGISTERS; r++) out += hexLittle(readRegister(emu, r), registerSize(r));
+			return out;
+		}
+
+		case 'G': {
+			size_t at = 0;
+			for (int r = 0; r < REGISTERS && at + registerSize(r) * 2 <= packet.size() - 1; r++) {
+				writeRegister(emu, r, parseLittle(args + at, registerSize(r)));
+				at += registerSize(r) * 2;
+			}
+			action |= MODIFIED;
+			return "OK";
+		}
+
+		case 'p': {
+			int r = (int)std::strtoul(args, nullptr, 16);
+			if (r >= REGISTERS) return "E01";
+			return hexLittle(readRegister(emu, r), registerSize(r));
+		}
+
+		case 'P': {
+			char* value = nullptr;
+			int r = (int)std::strtoul(args, &value, 16);
+			if (r >= REGISTERS || *value != '=') return "E01";
+			writeRegister(emu, r, parseLittle(value + 1, registerSize(r)));
+			action |= MODIFIED;
+			return "OK";
+		}
+
+		case 'm': {
+			char* rest = nullptr;
+			unsigned long address = std::strtoul(args, &rest, 16);
+			unsigned long length = (*rest == ',') ? std::strtoul(rest + 1, nullptr, 16) : 0;
+			if (address >= MAX_MEM) return "E01";
+			// short reads are fine by the protocol, and the reply has to fit a packet
+			length = std::min(length, std::min(MAX_MEM - address, PACKET_SIZE / 2));
+			std::string out;
+			for (unsigned long i = 0; i < length; i++) out += hexLittle(emu.mem[address + i], 1);
+			return out;
+		}
+
+		case 'M': {
+			char* rest = nullptr;
+			unsigned long address = std::strtoul(args, &rest, 16);
+			unsigned long length = (*rest == ',') ? std::strtoul(rest + 1, &rest, 16) : 0;
+			if (*rest != ':' || address >= MAX_MEM || length > MAX_MEM - address || std::strlen(rest + 1) / 2 < length) return "E01";
+			for (unsigned long i = 0; i < length; i++) emu.mem.write(address + i, (byte)parseLittle(rest + 1 + i * 2, 1));
+			action |= MODIFIED;
+			return "OK";
+		}
+
+		case 'Z':
+		case 'z': {
+			char* rest = nullptr;
+			int type = (int)std::strtoul(args, &rest, 16);
+			unsigned long address = (*rest == ',') ? std::strtoul(rest + 1, &rest, 16) : MAX_MEM;
+			unsigned long length = (*rest == ',') ? std::strtoul(rest + 1, nullptr, 16) : 1;
+			if (type > 4 || address >= MAX_MEM) return "E01";
+			bool on = packet[0] == 'Z';
+			if (type <= 1) {
+				breakpoints.set(Breakpoints::EXEC, (word)address, on);
+				return "OK";
+			}
+			if (length == 0) length = 1;
+			for (unsigned long i = 0; i < length && address + i < MAX_MEM; i++) {
+				if (type == 2 || type == 4) breakpoints.set(Breakpoints::WRITE, (word)(address + i), on);
+				if (type == 3 || type == 4) breakpoints.set(Breakpoints::READ, (word)(address + i), on);
+			}
+			return "OK";
+		}
+
+		case 's':
+		case 'c':
+			// resuming at another address isn't supported, set PC first instead
+			action |= (packet[0] == 's') ? STEP : RESUME;
+			signal = 5; // SIGTRAP
+			running = true;
+			interrupt = false;
+			return "";
+
+		case 'D':
+		case 'k':
+			if (stopped) action |= RESUME;
+			return "OK";
+		}
+		return "";
+	}
+
+	static int registerSize(int r) {
+		return (r == 16 || r == 17) ? 2 : 1;
+	}
+
+	static unsigned readRegister(const c8ke& emu, int r) {
+		if (r < 16) return emu.regs[r];
+		switch (r) {
+		case 16: return emu.iReg;
+		case 17: return emu.pc;
+		case 18: return emu.sp;
+		case 19: return emu.delayReg;
+		default: return emu.soundReg;
+		}
+	}
+
+	static void writeRegister(c8ke& emu, int r, unsigned value) {
+		if (r < 16) { emu.regs[r] = (byte)value; return; }
+		switch (r) {
+		case 16: emu.iReg = (word)value; break;
+		case 17: emu.pc = (word)value; break;
+		case 18: emu.sp = value < 16 ? (byte)value : 0xFF; break; // anything off the stack is empty
+		case 19: emu.delayReg = (byte)value; break;
+		default: emu.soundReg = (byte)value; break;
+		}
+	}
+
+	static std::string hexLittle(unsigned value, int bytes) {
+		char out[8];
+		for (int i = 0; i < bytes; i++) std::snprintf(out + i * 2, 3, "%02x", (value >> (i * 8)) & 0xFF);
+		return std::string(out, bytes * 2);
+	}
+
+	static unsigned parseLittle(const char* hex, int bytes) {
+		unsigned value = 0;
+		for (int i = 0; i < bytes; i++) {
+			char pair[3] = { hex[i * 2], hex[i * 2 + 1], '\0' };
+			value |= (unsigned)std::strtoul(pair, nullptr, 16) << (i * 8);
+		}
+		return value;
+	}
+
+	// describes the register file, clients without a built in chip8 target read this
+	static const char* targetXml() {
+		return "<?xml version=\"1.0\"?><!DOCTYPE target SYSTEM \"gdb-target.dtd\"><target version=\"1.0\"><feature name=\"org.c8ke.chip8\">"
+			"<reg name=\"v0\" bitsize=\"8\" type=\"uint8\" regnum=\"0\"/><reg name=\"v1\" bitsize=\"8\" type=\"uint8\"/><reg name=\"v2\" bitsize=\"8\" type=\"uint8\"/>"
+			"<reg name=\"v3\" bitsize=\"8\" type=\"uint8\"/><reg name=\"v4\" bitsize=\"8\" type=\"uint8\"/><reg name=\"v5\" bitsize=\"8\" type=\"uint8\"/>"
+			"<reg name=\"v6\" bitsize=\"8\" type=\"uint8\"/><reg name=\"v7\" bitsize=\"8\" type=\"uint8\"/><reg name=\"v8\" bitsize=\"8\" type=\"uint8\"/>"
+			"<reg name=\"v9\" bitsize=\"8\" type=\"uint8\"/><reg name=\"va\" bitsize=\"8\" type=\"uint8\"/><reg name=\"vb\" bitsize=\"8\" type=\"uint8\"/>"
+			"<reg name=\"vc\" bitsize=\"8\" type=\"uint8\"/><reg name=\"vd\" bitsize=\"8\" type=\"uint8\"/><reg name=\"ve\" bitsize=\"8\" type=\"uint8\"/>"
+			"<reg name=\"vf\" bitsize=\"8\" type=\"uint8\"/><reg name=\"i\" bitsize=\"16\" type=\"data_ptr\"/><reg name=\"pc\" bitsize=\"16\" type=\"code_ptr\"/>"
+			"<reg name=\"sp\" bitsize=\"8\" type=\"uint8\"/><reg name=\"dt\" bitsize=\"8\" type=\"uint8\"/><reg name=\"st\" bitsize=\"8\" type=\"uint8\"/>"
+			"</feature></target>";
+	}
+
+	// server thread
+	void serve() {
+		while (!stopping) {
+			// shutdown() on a listening socket doesn't wake accept() on windows, so
+			// it only runs once a client is there and stop() is seen within 100 ms
+			fd_set readable;
+			FD_ZERO(&readable);
+			FD_SET(listener, &readable);
+			timeval timeout{ 0, 100 * 1000 };
+			if (select((int)listener + 1, &readable, nullptr, nullptr, &timeout) <= 0) continue;
+
+			Socket accepted = accept(listener, nullptr, nullptr);
+			if (accepted == NO_SOCKET) {
+				if (stopping) return;
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				continue;
+			}
+			int on = 1;
+			setsockopt(accepted, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on)); // replies are tiny, don't let nagle sit on them
+			client = accepted;
+			buffered.clear();
+			acks = true;
+
+			std::string packet;
+			while (!stopping && readPacket(packet)) {
+				if (packet.empty()) continue;
+				std::string reply = needsMachine(packet[0]) ? call(packet) : answerLocally(packet);
+				if (stopping) break;
+				sendPacket(reply);
+				if (packet == "QStartNoAckMode") acks = false;
+				if (packet[0] == 'D' || packet[0] == 'k') break;
+			}
+
+			// a client that drops off mid run leaves the machine running
+			if (!stopping) call("D");
+			Socket closing = client;
+			client = NO_SOCKET;
+			closeSocket(closing);
+		}
+	}
+
+	std::string answerLocally(const std::string& packet) {
+		if (packet.rfind("qSupported", 0) == 0) return "PacketSize=1000;qXfer:features:read+;QStartNoAckMode+";
+		if (packet == "QStartNoAckMode") return "OK";
+		if (packet.rfind("qXfer:features:read:target.xml:", 0) == 0) {
+			char* rest = nullptr;
+			size_t offset = std::strtoul(packet.c_str() + 31, &rest, 16);
+			size_t length = (*rest == ',') ? std::strtoul(rest + 1, nullptr, 16) : 0;
+			std::string xml = targetXml();
+			if (offset >= xml.size()) return "l";
+			std::string chunk = xml.substr(offset, length);
+			return ((offset + chunk.size() >= xml.size()) ? "l" : "m") + chunk;
+		}
+		if (packet == "qAttached") return "1";
+		if (packet == "qfThreadInfo") return "m1";
+		if (packet == "qsThreadInfo") return "l";
+		if (packet == "qC") return "QC1";
+		if (packet == "qOffsets") return "Text=0;Data=0;Bss=0";
+		if (packet[0] == 'H' || packet[0] == 'T') return "OK";
+		return ""; // unsupported, the client falls back or gives up on the feature
+	}
+
+	// hands a packet to the emulation thread and waits for its reply. while a
+	// continue is out this keeps an eye on the socket for ctrl-c.
+	std::string call(const std::string& packet) {
+		std::unique_lock<std::mutex> lock(mutex);
+		request = packet;
+		pending = true;
+		answered = false;
+		waiting.store(true, std::memory_order_release);
+		while (!answered && !stopping) {
+			if (replied.wait_for(lock, std::chrono::milliseconds(20)) == std::cv_status::timeout) {
+				lock.unlock();
+				if (pollInterrupt()) interrupt = true;
+				lock.lock();
+			}
+		}
+		return reply;
+	}
+
+	// emulation thread, with the mutex held
+	void answer(const std::string& text) {
+		reply = text;
+		answered = true;
+		waiting.store(false, std::memory_order_release);
+		replied.notify_all();
+	}
+
+	// true on ctrl-c or a dropped connection, which should stop the machine the same way
+	bool pollInterrupt() {
+		Socket s = client;
+		fd_set readable;
+		FD_ZERO(&readable);
+		FD_SET(s, &readable);
+		timeval timeout{ 0, 0 };
+		if (select((int)s + 1, &readable, nullptr, nullptr, &timeout) <= 0) return false;
+
+		char data[256];
+		int received = recv(s, data, sizeof(data), 0);
+		if (received <= 0) return true;
+		bool hit = false;
+		for (int i = 0; i < received; i++) {
+			if (data[i] == 0x03) hit = true;
+			else buffered += data[i];
+		}
+		return hit;
+	}
+
+	bool readByte(char& c) {
+		if (buffered.empty()) {
+			char data[1024];
+			int received = recv(client, data, sizeof(data), 0);
+			if (received <= 0) return false;
+			buffered.assign(data, received);
+		}
+		c = buffered[0];
+		buffered.erase(0, 1);
+		return true;
+	}
+
+	// $data#checksum, acks and stray ctrl-c bytes between packets are skipped
+	bool readPacket(std::string& packet) {
+		char c = 0;
+		do { if (!readByte(c)) return false; } while (c != '$');
+
+		packet.clear();
+		unsigned sum = 0;
+		while (readByte(c) && c != '#') {
+			packet += c;
+			sum += (byte)c;
+		}
+		char checksum[3] = { 0, 0, 0 };
+		if (c != '#' || !readByte(checksum[0]) || !readByte(checksum[1])) return false;
+
+		bool valid = std::strtoul(checksum, nullptr, 16) == (sum & 0xFF);
+		if (acks) sendRaw(valid ? "+" : "-");
+		if (!valid) packet.clear(); // the client resends
+		return true;
+	}
+
+	void sendPacket(const std::string& data) {
+		unsigned sum = 0;
+		for (char c : data) sum += (byte)c;
+		char checksum[4];
+		std::snprintf(checksum, sizeof(checksum), "#%02x", sum & 0xFF);
+		sendRaw("$" + data + checksum);
+	}
+
+	void sendRaw(const std::string& data) {
+		size_t sent = 0;
+		while (sent < data.size()) {
+			int n = send(client, data.c_str() + sent, (int)(data.size() - sent), 0);
+			if (n <= 0) return;
+			sent += n;
+		}
+	}
+
+	static void shutdownSocket(Socket s) {
+		if (s == NO_SOCKET) return;
+#if defined(_WIN32)
+		shutdown(s, SD_BOTH);
+#else
+		shutdown(s, SHUT_RDWR);
+#endif
+	}
+
+	static void closeSocket(Socket& s) {
+		if (s == NO_SOCKET) return;
+#if defined(_WIN32)
+		closesocket(s);
+#else
+		close(s);
+#endif
+		s = NO_SOCKET;
+	}
+
+	std::thread server;
+	std::atomic<bool> stopping{ false };
+	Socket listener = NO_SOCKET;
+	std::atomic<Socket> client{ NO_SOCKET };
+	std::string buffered; // received but not parsed yet
+	bool acks = true; // off after QStartNoAckMode
+
+	// mailbox between the server thread and service()
+	std::mutex mutex;
+	std::condition_variable replied;
+	std::atomic<bool> waiting{ false }; // a request or a stop is outstanding
+	std::atomic<bool> interrupt{ false };
+	std::string request;
+	std::string reply;
+	bool pending = false;
+	bool answered = false;
+	bool running = false; // a continue or step waits for the machine to stop
+	int signal = 5;
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "core.h"
+#include "profiler.h"
+
+/***** memory heatmap *****/
+
+// per byte access counters for mem, fed by the execute/read/write hooks of
+// cycle(). the totals cover the whole session for the coverage export, the
+// heat values fade every frame so the debugger shows what is hot right now.
+struct MemoryHeatmap : NoProbe {
+	enum Channel { READ, WRITE, EXECUTE, CHANNELS };
+
+	uint64_t counts[CHANNELS][MAX_MEM]{};
+	float heat[CHANNELS][MAX_MEM]{};
+
+	void reset() {
+		std::memset(counts, 0, sizeof(counts));
+		std::memset(heat, 0, sizeof(heat));
+	}
+
+	void execute(word pc, word instruction) {
+		touch(EXECUTE, pc, instructionSize(instruction)); // F000 and 01nn cover their operand word too
+	}
+
+	void read(word address, word count) {
+		touch(READ, address, count);
+	}
+
+	void write(word address, word count) {
+		touch(WRITE, address, count);
+	}
+
+	// called once per displayed frame, only for the first size bytes the view shows
+	void decay(float factor, int size = MAX_MEM) {
+		for (int c = 0; c < CHANNELS; c++) {
+			for (int i = 0; i < size; i++) heat[c][i] *= factor;
+		}
+	}
+
+	// one RGBA texel per byte, red = writes, green = executes, blue = reads.
+	// 1 - e^-heat keeps a single access visible without hot loops saturating everything.
+	void toRgba(byte* out, int size = MAX_MEM) const {
+		for (int i = 0; i < size; i++) {
+			out[i * 4 + 0] = shade(heat[WRITE][i]);
+			out[i * 4 + 1] = shade(heat[EXECUTE][i]);
+			out[i * 4 + 2] = shade(heat[READ][i]);
+			out[i * 4 + 3] = 255;
+		}
+	}
+
+	// text map of the rom area, one character per byte, 32 bytes per line
+	bool writeCoverage(const std::string& path, word romSize) const {
+		std::ofstream out(path);
+		if (!out.is_open()) return false;
+
+		int executed = 0, data = 0, untouched = 0;
+		for (int i = START_ADDRESS; i < START_ADDRESS + romSize; i++) {
+			char c = mark(i);
+			if (c == 'X') executed++;
+			else if (c == '.') untouched++;
+			else data++;
+		}
+
+		char line[128];
+		std::snprintf(line, sizeof(line), "# c8ke coverage, rom 0x%03X-0x%03X (%d bytes)\n", START_ADDRESS, START_ADDRESS + romSize - 1, romSize);
+		out << line;
+		std::snprintf(line, sizeof(line), "# executed %d (%.1f%%), data only %d, untouched %d\n", executed, romSize ? 100.0 * executed / romSize : 0.0, data, untouched);
+		out << line;
+		out << "# X executed, R read, W written, B read and written, . untouched\n";
+
+		for (int row = START_ADDRESS; row < START_ADDRESS + romSize; row += 32) {
+			std::snprintf(line, sizeof(line), "0x%03X  ", row);
+			out << line;
+			for (int i = row; i < row + 32 && i < START_ADDRESS + romSize; i++) out << mark(i);
+			out << '\n';
+		}
+		return true;
+	}
+
+private:
+	void touch(Channel channel, word address, word count) {
+		for (word i = 0; i < count; i++) {
+			int a = (address + i) & (MAX_MEM - 1);
+			counts[channel][a]++;
+			heat[channel][a] += 1.0f;
+		}
+	}
+
+	char mark(int address) const {
+		if (counts[EXECUTE][address]) return 'X';
+		bool read = counts[READ][address] != 0;
+		bool written = counts[WRITE][address] != 0;
+		if (read && written) return 'B';
+		if (read) return 'R';
+		if (written) return 'W';
+		return '.';
+	}
+
+	static byte shade(float value) {
+		return (byte)(255.0f * (1.0f - std::exp(-value)));
+	}
+};
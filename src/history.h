@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "core.h"
+#include "breakpoints.h"
+
+/***** execution history *****/
+
+// reverse debugging by snapshots and replay. every `interval` cycles a fork of
+// the machine is kept as a keyframe (memory pages and the screens are shared,
+// so a keyframe is about 1.2KB plus whatever gets dirtied after it), and the
+// only inputs the core takes from outside, key presses and 60 Hz timer ticks,
+// are logged against the cycle count. the rng lives in the machine, so replaying
+// from a keyframe with the same events rebuilds any earlier cycle exactly.
+class History {
+public:
+	static const size_t MAX_KEYFRAMES = 4096; // oldest quarter is dropped past this
+	static const int64_t STEP_BUDGET = 500000; // ns a step back may spend replaying, half the 1ms target
+
+	// starts over at the current state, e.g. after loading a rom
+	void reset(const c8ke& emu) {
+		keyframes.clear();
+		events.clear();
+		count = 0;
+		keyframes.push_back({ 0, 0, emu.fork() });
+	}
+
+	uint64_t cycles() const { return count; }
+	uint64_t oldest() const { return keyframes.empty() ? 0 : keyframes.front().cycle; }
+	size_t keyframeCount() const { return keyframes.size(); }
+	uint64_t keyframeInterval() const { return interval; }
+
+	// the frontend calls these around every cycle() and for every outside input
+	void beforeCycle(const c8ke& emu) {
+		if (keyframes.empty() || count - keyframes.back().cycle >= interval) addKeyframe(emu);
+	}
+
+	void afterCycle() { count++; }
+	void tick() { if (!keyframes.empty()) events.push_back({ count, TICK, 0, false }); }
+	void press(byte key, bool pressed) { if (!keyframes.empty()) events.push_back({ count, PRESS, key, pressed }); }
+
+	// rebuilds the machine as it was `target` cycles in and forgets everything
+	// after it, running on from there records a new future
+	bool seek(c8ke& emu, uint64_t target) {
+		if (keyframes.empty() || target < oldest() || target > count) return false;
+
+		auto start = std::chrono::steady_clock::now();
+		size_t k = keyframeAt(target);
+		replay(emu, k, target);
+		adapt(target - keyframes[k].cycle, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+
+		truncate(target);
+		return true;
+	}
+
+	bool stepBack(c8ke& emu) {
+		return count > oldest() && seek(emu, count - 1);
+	}
+
+	// goes back to the latest earlier cycle where `breakpoints` would have stopped,
+	// or to the start of the history if there is none. the scan runs on a copy so
+	// hit counts and register watches of the live breakpoints are untouched.
+	bool reverseContinue(c8ke& emu, Breakpoints& breakpoints) {
+		uint64_t end = count;
+		for (size_t k = keyframeAt(count ? count - 1 : 0) + 1; k-- > 0; ) {
+			Breakpoints scan = breakpoints;
+			scan.restart();
+
+			c8ke machine = keyframes[k].emu.fork();
+			scan.sync(machine);
+			size_t e = keyframes[k].event;
+			uint64_t at = keyframes[k].cycle;
+			uint64_t found = UINT64_MAX;
+			while (at < end) {
+				if (scan.shouldBreak(machine)) found = at;
+				machine.cycle(scan);
+				at++;
+				apply(machine, e, at);
+				if (scan.takeTrigger() && at < end) found = at; // watchpoints stop after the access
+			}
+
+			if (found != UINT64_MAX) {
+				seek(emu, found);
+				std::memcpy(breakpoints.reason, scan.reason, sizeof(breakpoints.reason));
+				return true;
+			}
+			end = keyframes[k].cycle;
+		}
+
+		seek(emu, oldest());
+		return false;
+	}
+
+private:
+	enum Kind : byte { TICK, PRESS };
+
+	struct Event {
+		uint64_t cycle; // cycles run before it happened
+		Kind kind;
+		byte key;
+		bool pressed;
+	};
+
+	struct Keyframe {
+		uint64_t cycle;
+		size_t event; // first event not yet applied to the snapshot
+		c8ke emu;
+	};
+
+	void addKeyframe(const c8ke& emu) {
+		if (keyframes.size() >= MAX_KEYFRAMES) {
+			// drop the oldest quarter along with the events only they needed
+			size_t drop = MAX_KEYFRAMES / 4;
+			keyframes.erase(keyframes.begin(), keyframes.begin() + drop);
+			size_t firstEvent = keyframes.front().event;
+			events.erase(events.begin(), events.begin() + firstEvent);
+			for (Keyframe& keyframe : keyframes) keyframe.event -= firstEvent;
+		}
+		keyframes.push_back({ count, events.size(), emu.fork() });
+	}
+
+	// last keyframe at or before cycle
+	size_t keyframeAt(uint64_t cycle) const {
+		auto it = std::upper_bound(keyframes.begin(), keyframes.end(), cycle, [](uint64_t c, const Keyframe& k) { return c < k.cycle; });
+		return (it == keyframes.begin()) ? 0 : (size_t)(it - keyframes.begin()) - 1;
+	}
+
+	// events logged at `at` happened after that many cycles had run
+	void apply(c8ke& machine, size_t& e, uint64_t at) const {
+		while (e < events.size() && events[e].cycle <= at) {
+			const Event& event = events[e++];
+			if (event.cycle < at) continue;
+			if (event.kind == TICK) machine.tick();
+			else machine.press(event.key, event.pressed);
+		}
+	}
+
+	void replay(c8ke& emu, size_t k, uint64_t target) const {
+		emu = keyframes[k].emu.fork();
+		size_t e = keyframes[k].event;
+		uint64_t at = keyframes[k].cycle;
+		apply(emu, e, at);
+		while (at < target) {
+			emu.cycle();
+			at++;
+			apply(emu, e, at);
+		}
+	}
+
+	// keeps a worst case step back inside STEP_BUDGET at the measured replay speed
+	void adapt(uint64_t replayed, int64_t elapsed) {
+		if (replayed < 100 || elapsed <= 0) return; // too short to time
+		double perCycle = (double)elapsed / replayed;
+		interval = (uint64_t)std::clamp(STEP_BUDGET / perCycle, 256.0, (double)(1 << 20));
+	}
+
+	void truncate(uint64_t target) {
+		count = target;
+		while (keyframes.size() > 1 && keyframes.back().cycle > target) keyframes.pop_back();
+		auto firstAfter = std::find_if(events.begin() + keyframes.back().event, events.end(), [&](const Event& event) { return event.cycle > target; });
+		events.erase(firstAfter, events.end());
+	}
+
+	std::vector<Keyframe> keyframes;
+	std::vector<Event> events;
+	uint64_t count = 0; // cycles run since reset()
+	uint64_t interval = 1000;
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+
+#include "core.h"
+
+/***** performance monitor *****/
+
+// last N samples of one metric. fixed storage, so it can be fed every frame
+// forever, and the stats are recomputed from the window on demand.
+template <int N>
+class RollingStats {
+public:
+	void push(float value) {
+		values[next] = value;
+		next = (next + 1) % N;
+		if (count < N) count++;
+	}
+
+	int size() const { return count; }
+	const float* data() const { return values; }
+	int offset() const { return count < N ? 0 : next; } // oldest sample, for ImGui::PlotHistogram
+	float last() const { return count ? values[(next + N - 1) % N] : 0.0f; }
+
+	float min() const {
+		if (!count) return 0.0f;
+		return *std::min_element(values, values + count);
+	}
+
+	float max() const {
+		if (!count) return 0.0f;
+		return *std::max_element(values, values + count);
+	}
+
+	float avg() const {
+		if (!count) return 0.0f;
+		double sum = 0.0;
+		for (int i = 0; i < count; i++) sum += values[i];
+		return (float)(sum / count);
+	}
+
+	float percentile(float p) const {
+		if (!count) return 0.0f;
+		float sorted[N];
+		std::copy(values, values + count, sorted);
+		int k = std::min(count - 1, (int)std::ceil(p * count) - 1);
+		if (k < 0) k = 0;
+		std::nth_element(sorted, sorted + k, sorted + count);
+		return sorted[k];
+	}
+
+private:
+	float values[N]{};
+	int next = 0;
+	int count = 0;
+};
+
+// pacing health of the realtime loop. run() reports every cycle burst and
+// every refresh, the overlay reads the rolling windows.
+struct PerfMonitor {
+	static const int WINDOW = 240; // four seconds of frames
+
+	RollingStats<WINDOW> frameMs; // time between refreshes
+	RollingStats<WINDOW> jitterMs; // |frame time - 1/FPS|
+	RollingStats<WINDOW> cyclesPerFrame; // instructions executed per vblank
+	RollingStats<WINDOW> burstCycles; // largest burst in each frame
+	RollingStats<WINDOW> audioMs; // how far the audio trails the emulation at each refresh
+	RollingStats<60> instructionsPerSecond; // one sample per second
+
+	uint64_t catchUps = 0; // bursts that ran more than one cycle to catch up
+	uint64_t largestBurst = 0;
+
+	// one pass of the main loop's cycle loop
+	void burst(int cycles) {
+		frameCycles += cycles;
+		windowCycles += cycles;
+		if (cycles > frameBurst) frameBurst = cycles;
+		if (cycles > 1) catchUps++;
+		if ((uint64_t)cycles > largestBurst) largestBurst = cycles;
+	}
+
+	// called at every refresh with the loop's clock in ns
+	void frame(int64_t now, float audioLagMs) {
+		if (lastFrame) {
+			float interval = (float)((now - lastFrame) / 1e6);
+			frameMs.push(interval);
+			jitterMs.push(std::fabs(interval - (float)(TIME_PER_REFRESH / 1e6)));
+			cyclesPerFrame.push((float)frameCycles);
+			burstCycles.push((float)frameBurst);
+			audioMs.push(audioLagMs);
+		} else {
+			windowStart = now;
+		}
+		lastFrame = now;
+		frameCycles = 0;
+		frameBurst = 0;
+
+		if (now - windowStart >= 1000000000) {
+			instructionsPerSecond.push((float)(windowCycles * 1e9 / (now - windowStart)));
+			windowStart = now;
+			windowCycles = 0;
+		}
+	}
+
+	// after pauses and dialogs, the gap would show up as one giant frame
+	void restart() {
+		lastFrame = 0;
+		frameCycles = 0;
+		frameBurst = 0;
+		windowCycles = 0;
+	}
+
+private:
+	int64_t lastFrame = 0;
+	int64_t windowStart = 0;
+	int frameCycles = 0;
+	int frameBurst = 0;
+	uint64_t windowCycles = 0;
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads that split an index range between them,
+// kept alive between calls so batches don't pay for thread creation
+class ThreadPool {
+public:
+	explicit ThreadPool(int threads = 0) {
+		if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+		if (threads <= 0) threads = 1;
+		for (int i = 1; i < threads; i++) // the calling thread is worker 0
+			workers.emplace_back([this] { work(); });
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread& t : workers) t.join();
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	int size() const { return (int)workers.size() + 1; }
+
+	// runs fn(i) for every i in [0, count) and returns once all of them finished
+	void parallelFor(int count, const std::function<void(int)>& fn) {
+		if (count <= 0) return;
+		if (workers.empty() || count == 1) {
+			for (int i = 0; i < count; i++) fn(i);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = &fn;
+			jobCount = count;
+			next = 0;
+			active = (int)workers.size();
+			generation++;
+		}
+		wake.notify_all();
+
+		drain();
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this] { return active == 0; });
+		job = nullptr;
+	}
+
+private:
+	void drain() {
+		for (int i = next.fetch_add(1); i < jobCount; i = next.fetch_add(1))
+			(*job)(i);
+	}
+
+	void work() {
+		unsigned long long seen = 0;
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&] { return stopping || generation != seen; });
+				if (stopping) return;
+				seen = generation;
+			}
+
+			drain();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--active == 0) done.notify_one();
+		}
+	}
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	const std::function<void(int)>* job = nullptr;
+	int jobCount = 0;
+	std::atomic<int> next{ 0 };
+	int active = 0;
+	unsigned long long generation = 0;
+	bool stopping = false;
+};
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "core.h"
+
+/***** opcode classes *****/
+
+enum OpcodeClass {
+	OP_00E0, OP_00EE, OP_0NNN, OP_1NNN, OP_2NNN, OP_3XKK, OP_4XKK, OP_5XY0,
+	OP_6XKK, OP_7XKK, OP_8XY0, OP_8XY1, OP_8XY2, OP_8XY3, OP_8XY4, OP_8XY5,
+	OP_8XY6, OP_8XY7, OP_8XYE, OP_9XY0, OP_ANNN, OP_BNNN, OP_CXKK, OP_DXYN,
+	OP_EX9E, OP_EXA1, OP_FX07, OP_FX0A, OP_FX15, OP_FX18, OP_FX1E, OP_FX29,
+	OP_FX33, OP_FX55, OP_FX65, OP_F002, OP_FX3A, OP_00CN, OP_00FB, OP_00FC,
+	OP_00FD, OP_00FE, OP_00FF, OP_FX30, OP_FX75, OP_FX85, OP_00DN, OP_5XY2,
+	OP_5XY3, OP_F000, OP_FX01, OP_0010, OP_0011, OP_00BN, OP_01NN, OP_02NN,
+	OP_03NN, OP_04NN, OP_05NN, OP_060N, OP_0700, OP_080N, OP_09NN, OP_UNKNOWN,
+	OPCODE_CLASSES,
+};
+
+const char* const opcodeNames[OPCODE_CLASSES] = {
+	"00E0", "00EE", "0nnn", "1nnn", "2nnn", "3xkk", "4xkk", "5xy0",
+	"6xkk", "7xkk", "8xy0", "8xy1", "8xy2", "8xy3", "8xy4", "8xy5",
+	"8xy6", "8xy7", "8xyE", "9xy0", "Annn", "Bnnn", "Cxkk", "Dxyn",
+	"Ex9E", "ExA1", "Fx07", "Fx0A", "Fx15", "Fx18", "Fx1E", "Fx29",
+	"Fx33", "Fx55", "Fx65", "F002", "Fx3A", "00Cn", "00FB", "00FC",
+	"00FD", "00FE", "00FF", "Fx30", "Fx75", "Fx85", "00Dn", "5xy2",
+	"5xy3", "F000", "Fx01", "0010", "0011", "00Bn", "01nn", "02nn",
+	"03nn", "04nn", "05nn", "060n", "0700", "080n", "09nn", "????",
+};
+
+// the megachip 01nn-09nn are classed as such in any mode, they are only 0nnn
+// calls in roms that never run 0011 and those don't make them
+inline OpcodeClass opcodeClass(word instruction) {
+	switch (instruction & 0xF000) {
+	case 0x0000:
+		switch (instruction & 0xFF00) {
+		case 0x0100: return OP_01NN;
+		case 0x0200: return OP_02NN;
+		case 0x0300: return OP_03NN;
+		case 0x0400: return OP_04NN;
+		case 0x0500: return OP_05NN;
+		case 0x0600: return (instruction & 0xF0) == 0 ? OP_060N : OP_0NNN;
+		case 0x0700: return (instruction & 0xFF) == 0 ? OP_0700 : OP_0NNN;
+		case 0x0800: return (instruction & 0xF0) == 0 ? OP_080N : OP_0NNN;
+		case 0x0900: return OP_09NN;
+		}
+		if (instruction == 0x00E0) return OP_00E0;
+		if (instruction == 0x00EE) return OP_00EE;
+		if ((instruction & 0xFFF0) == 0x00C0) return OP_00CN;
+		if ((instruction & 0xFFF0) == 0x00D0) return OP_00DN;
+		if ((instruction & 0xFFF0) == 0x00B0) return OP_00BN;
+		switch (instruction) {
+		case 0x0010: return OP_0010;
+		case 0x0011: return OP_0011;
+		case 0x00FB: return OP_00FB;
+		case 0x00FC: return OP_00FC;
+		case 0x00FD: return OP_00FD;
+		case 0x00FE: return OP_00FE;
+		case 0x00FF: return OP_00FF;
+		}
+		return OP_0NNN;
+	case 0x1000: return OP_1NNN;
+	case 0x2000: return OP_2NNN;
+	case 0x3000: return OP_3XKK;
+	case 0x4000: return OP_4XKK;
+	case 0x5000:
+		switch (instruction & 0xF) {
+		case 0x0: return OP_5XY0;
+		case 0x2: return OP_5XY2;
+		case 0x3: return OP_5XY3;
+		}
+		return OP_UNKNOWN;
+	case 0x6000: return OP_6XKK;
+	case 0x7000: return OP_7XKK;
+	case 0x8000:
+		switch (instruction & 0xF) {
+		case 0x0: return OP_8XY0;
+		case 0x1: return OP_8XY1;
+		case 0x2: return OP_8XY2;
+		case 0x3: return OP_8XY3;
+		case 0x4: return OP_8XY4;
+		case 0x5: return OP_8XY5;
+		case 0x6: return OP_8XY6;
+		case 0x7: return OP_8XY7;
+		case 0xE: return OP_8XYE;
+		}
+		return OP_UNKNOWN;
+	case 0x9000: return (instruction & 0xF) == 0 ? OP_9XY0 : OP_UNKNOWN;
+	case 0xA000: return OP_ANNN;
+	case 0xB000: return OP_BNNN;
+	case 0xC000: return OP_CXKK;
+	case 0xD000: return OP_DXYN;
+	case 0xE000:
+		if ((instruction & 0xFF) == 0x9E) return OP_EX9E;
+		if ((instruction & 0xFF) == 0xA1) return OP_EXA1;
+		return OP_UNKNOWN;
+	case 0xF000:
+		switch (instruction & 0xFF) {
+		case 0x07: return OP_FX07;
+		case 0x0A: return OP_FX0A;
+		case 0x15: return OP_FX15;
+		case 0x18: return OP_FX18;
+		case 0x1E: return OP_FX1E;
+		case 0x29: return OP_FX29;
+		case 0x33: return OP_FX33;
+		case 0x55: return OP_FX55;
+		case 0x65: return OP_FX65;
+		case 0x00: return (instruction & 0x0F00) == 0 ? OP_F000 : OP_UNKNOWN;
+		case 0x01: return OP_FX01;
+		case 0x02: return (instruction & 0x0F00) == 0 ? OP_F002 : OP_UNKNOWN;
+		case 0x3A: return OP_FX3A;
+		case 0x30: return OP_FX30;
+		case 0x75: return OP_FX75;
+		case 0x85: return OP_FX85;
+		}
+		return OP_UNKNOWN;
+	}
+	return OP_UNKNOWN;
+}
+
+// F000 nnnn and 01nn nnnn carry an address in the next word
+inline int instructionSize(word instruction) {
+	OpcodeClass op = opcodeClass(instruction);
+	return (op == OP_F000 || op == OP_01NN) ? 4 : 2;
+}
+
+
+
+/***** profiler *****/
+
+// counting probe for c8ke::cycle(). tracks executions per opcode class and per
+// pc, plus cycles per subroutine from its own stack of 2nnn targets (the
+// guest stack only holds return addresses).
+struct Profiler : NoProbe {
+	struct Routine {
+		uint64_t calls = 0;
+		uint64_t selfCycles = 0; // executed while this routine was innermost
+		uint64_t totalCycles = 0; // including callees, added when the routine returns
+	};
+
+	uint64_t cycles = 0;
+	uint64_t opcodeCounts[OPCODE_CLASSES]{};
+	uint64_t pcCounts[MAX_MEM]{};
+	Routine routines[MAX_MEM]{}; // indexed by entry address, START_ADDRESS is the main program
+
+	struct Frame {
+		word entry;
+		uint64_t startCycle;
+	};
+	Frame frames[16]{};
+	int depth = 0; // frames in use, 0 means main
+	int overflow = 0; // calls past the 16th that weren't pushed, their returns don't pop
+
+	void reset() {
+		cycles = 0;
+		depth = 0;
+		overflow = 0;
+		std::memset(opcodeCounts, 0, sizeof(opcodeCounts));
+		std::memset(pcCounts, 0, sizeof(pcCounts));
+		for (Routine& r : routines) r = Routine();
+		routines[START_ADDRESS].calls = 1;
+	}
+
+	word current() const {
+		return depth > 0 ? frames[depth - 1].entry : START_ADDRESS;
+	}
+
+	void execute(word pc, word instruction) {
+		cycles++;
+		opcodeCounts[opcodeClass(instruction)]++;
+		pcCounts[pc & (MAX_MEM - 1)]++;
+		routines[current()].selfCycles++;
+
+		if ((instruction & 0xF000) == 0x2000) {
+			word entry = instruction & 0x0FFF;
+			routines[entry].calls++;
+			if (depth < 16) frames[depth++] = { entry, cycles };
+			else overflow++;
+		} else if (instruction == 0x00EE && overflow > 0) {
+			overflow--;
+		} else if (instruction == 0x00EE && depth > 0) {
+			const Frame& frame = frames[--depth];
+			routines[frame.entry].totalCycles += cycles - frame.startCycle;
+		}
+	}
+
+	// routines still on the stack haven't returned yet, count them up to now
+	uint64_t totalCycles(word entry) const {
+		if (entry == START_ADDRESS) return cycles; // main encloses everything
+		uint64_t total = routines[entry].totalCycles;
+		for (int i = 0; i < depth; i++) {
+			if (frames[i].entry == entry) total += cycles - frames[i].startCycle;
+		}
+		return total;
+	}
+
+	bool writeCsv(const std::string& path) const {
+		std::ofstream out(path);
+		if (!out.is_open()) return false;
+
+		char line[128];
+		out << "kind,name,address,count,self_cycles,total_cycles\n";
+		for (int i = 0; i < OPCODE_CLASSES; i++) {
+			if (!opcodeCounts[i]) continue;
+			std::snprintf(line, sizeof(line), "opcode,%s,,%llu,,\n", opcodeNames[i], (unsigned long long)opcodeCounts[i]);
+			out << line;
+		}
+		for (int pc = 0; pc < MAX_MEM; pc++) {
+			if (!pcCounts[pc]) continue;
+			std::snprintf(line, sizeof(line), "pc,,0x%03X,%llu,,\n", pc, (unsigned long long)pcCounts[pc]);
+			out << line;
+		}
+		for (int entry = 0; entry < MAX_MEM; entry++) {
+			const Routine& r = routines[entry];
+			if (!r.calls && !r.selfCycles) continue;
+			std::snprintf(line, sizeof(line), "routine,,0x%03X,%llu,%llu,%llu\n", entry, (unsigned long long)r.calls,
+				(unsigned long long)r.selfCycles, (unsigned long long)totalCycles((word)entry));
+			out << line;
+		}
+		return true;
+	}
+};
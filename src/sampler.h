@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "core.h"
+
+/***** sampling profiler *****/
+
+// statistical probe for c8ke::cycle(). every `interval` cycles it records the
+// guest call stack (stack[0..sp] plus pc) and counts identical stacks, so a
+// long session only costs one decrement per instruction and memory bounded
+// by maxStacks distinct stacks.
+class Sampler : public NoProbe {
+public:
+	Sampler(const c8ke& emu, uint32_t interval = 100, size_t maxStacks = 1 << 16) : emu(emu), interval(interval ? interval : 1), countdown(this->interval), maxStacks(maxStacks) {}
+
+	void execute(word pc, word instruction) {
+		if (--countdown != 0) return;
+		countdown = interval;
+		sample(pc);
+	}
+
+	uint64_t samples() const { return total; }
+	uint64_t truncated() const { return overflow; }
+
+	// one line per stack, "main;sub_0246;sub_0300 count", for flamegraph.pl / speedscope / inferno.
+	// stacks that only differ in pc are merged since folded frames are routines.
+	bool writeFolded(const std::string& path) const {
+		std::ofstream out(path);
+		if (!out.is_open()) return false;
+
+		std::map<std::string, uint64_t> folded;
+		char name[16];
+		for (const auto& [stack, count] : counts) {
+			std::string line = "main";
+			for (int i = 0; i < stack.depth; i++) {
+				std::snprintf(name, sizeof(name), ";sub_%04X", entryOf(stack.returns[i]));
+				line += name;
+			}
+			folded[line] += count;
+		}
+		if (overflow) folded["main;[truncated]"] += overflow;
+
+		for (const auto& [line, count] : folded) out << line << ' ' << count << '\n';
+		return true;
+	}
+
+	// profile.proto without compression, which pprof reads as is. locations are
+	// the sampled pc and the 2nnn call sites below it, functions are routine entries.
+	bool writePprof(const std::string& path) const {
+		std::ofstream out(path, std::ios::binary);
+		if (!out.is_open()) return false;
+
+		std::vector<std::string> strings = { "", "samples", "count", "cycles", "instructions" };
+		std::unordered_map<word, uint64_t> functions; // entry -> function id
+		std::unordered_map<uint32_t, uint64_t> locations; // (address << 16 | entry) -> location id
+		std::string profile, body;
+
+		auto functionId = [&](word entry) {
+			auto found = functions.find(entry);
+			if (found != functions.end()) return found->second;
+
+			uint64_t id = functions.size() + 1;
+			functions[entry] = id;
+			char name[16];
+			std::snprintf(name, sizeof(name), entry == START_ADDRESS ? "main" : "sub_%04X", entry);
+			strings.push_back(name);
+
+			body.clear();
+			putVarint(body, 1, id);
+			putVarint(body, 2, strings.size() - 1); // name
+			putVarint(body, 3, strings.size() - 1); // system_name
+			putVarint(body, 5, entry); // start_line
+			putBytes(profile, 5, body);
+			return id;
+		};
+
+		auto locationId = [&](word address, word entry) {
+			uint32_t key = ((uint32_t)address << 16) | entry;
+			auto found = locations.find(key);
+			if (found != locations.end()) return found->second;
+
+			uint64_t id = locations.size() + 1;
+			locations[key] = id;
+			std::string line;
+			putVarint(line, 1, functionId(entry));
+			putVarint(line, 2, address);
+
+			body.clear();
+			putVarint(body, 1, id);
+			putVarint(body, 3, address);
+			putBytes(body, 4, line);
+			putBytes(profile, 4, body);
+			return id;
+		};
+
+		std::string valueType;
+		putVarint(valueType, 1, 1); // "samples"
+		putVarint(valueType, 2, 2); // "count"
+		putBytes(profile, 1, valueType);
+
+		for (const auto& [stack, count] : counts) {
+			// leaf first: the sampled pc inside the innermost routine, then each call site
+			std::string ids;
+			word callee = stack.depth ? entryOf(stack.returns[stack.depth - 1]) : START_ADDRESS;
+			appendVarint(ids, locationId(stack.pc, callee));
+			for (int i = stack.depth - 1; i >= 0; i--) {
+				word caller = i ? entryOf(stack.returns[i - 1]) : START_ADDRESS;
+				appendVarint(ids, locationId((word)(stack.returns[i] - 2), caller));
+			}
+
+			std::string values;
+			appendVarint(values, count);
+
+			std::string sample;
+			putBytes(sample, 1, ids);
+			putBytes(sample, 2, values);
+			putBytes(profile, 2, sample);
+		}
+
+		for (const std::string& s : strings) putBytes(profile, 6, s);
+
+		std::string periodType;
+		putVarint(periodType, 1, 3); // "cycles"
+		putVarint(periodType, 2, 4); // "instructions"
+		putBytes(profile, 11, periodType);
+		putVarint(profile, 12, interval);
+
+		out.write(profile.data(), profile.size());
+		return true;
+	}
+
+private:
+	struct Stack {
+		word pc = 0;
+		int depth = 0;
+		word returns[16]{};
+
+		bool operator==(const Stack& other) const {
+			return pc == other.pc && depth == other.depth && std::memcmp(returns, other.returns, depth * sizeof(word)) == 0;
+		}
+	};
+
+	struct StackHash {
+		size_t operator()(const Stack& stack) const {
+			uint64_t h = mix64(stack.pc | ((uint64_t)stack.depth << 16));
+			for (int i = 0; i < stack.depth; i++) h = mix64(h ^ stack.returns[i]);
+			return (size_t)h;
+		}
+	};
+
+	void sample(word pc) {
+		total++;
+
+		Stack stack;
+		stack.pc = pc;
+		stack.depth = (emu.sp == 0xFF) ? 0 : (emu.sp & 0xF) + 1; // sp is -1 in main
+		for (int i = 0; i < stack.depth; i++) stack.returns[i] = emu.stack[i];
+
+		auto found = counts.find(stack);
+		if (found != counts.end()) found->second++;
+		else if (counts.size() < maxStacks) counts.emplace(stack, 1);
+		else overflow++;
+	}
+
+	// the routine a return address belongs to is the target of the 2nnn just before it
+	word entryOf(word returnAddress) const {
+		word call = (emu.mem[returnAddress - 2] << 8) | emu.mem[returnAddress - 1];
+		return ((call & 0xF000) == 0x2000) ? (call & 0x0FFF) : (word)(returnAddress - 2);
+	}
+
+	static void appendVarint(std::string& out, uint64_t value) {
+		while (value >= 0x80) { out += (char)((value & 0x7F) | 0x80); value >>= 7; }
+		out += (char)value;
+	}
+
+	static void putVarint(std::string& out, int field, uint64_t value) {
+		appendVarint(out, (uint64_t)field << 3);
+		appendVarint(out, value);
+	}
+
+	static void putBytes(std::string& out, int field, const std::string& bytes) {
+		appendVarint(out, ((uint64_t)field << 3) | 2);
+		appendVarint(out, bytes.size());
+		out += bytes;
+	}
+
+	const c8ke& emu;
+	uint32_t interval;
+	uint32_t countdown;
+	size_t maxStacks;
+	uint64_t total = 0;
+	uint64_t overflow = 0;
+	std::unordered_map<Stack, uint64_t, StackHash> counts;
+};
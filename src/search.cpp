@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <optional>
+
+#include "search.h"
+#include "pool.h"
+
+
+
+/***** input search *****/
+
+SearchResult searchInputs(const c8ke& start, const SearchConfig& config, const std::function<bool(const c8ke&)>& goal) {
+	SearchResult result;
+
+	std::vector<uint16_t> actions = config.actions;
+	if (actions.empty()) {
+		actions.push_back(0);
+		for (int k = 0; k < 16; k++) actions.push_back((uint16_t)(1 << k));
+	}
+	const int framesPerInput = std::max(1, config.framesPerInput);
+
+	// every explored input, linked back to its parent so the winning path can be rebuilt
+	struct Step {
+		int parent;
+		uint16_t input;
+	};
+	std::vector<Step> steps;
+
+	struct Node {
+		c8ke emu;
+		int step; // index into steps, -1 for the start state
+	};
+	std::vector<Node> frontier{ { start.fork(), -1 } };
+
+	if (goal(start)) {
+		result.found = true;
+		return result;
+	}
+
+	TranspositionTable seen(config.tableSize);
+	seen.insert(start.hash());
+	ThreadPool pool(config.threads);
+
+	struct Child {
+		std::optional<c8ke> emu; // empty until expanded, default machines would allocate their own pages
+		uint64_t hash = 0;
+		bool keep = false;
+		bool goal = false;
+	};
+	std::vector<Child> children;
+
+	for (int depth = 0; depth < config.maxDepth && !frontier.empty(); depth++) {
+		const size_t count = frontier.size() * actions.size();
+		children.clear();
+		children.resize(count);
+
+		std::atomic<size_t> duplicates{ 0 };
+		pool.parallelFor((int)count, [&](int i) {
+			const Node& parent = frontier[i / actions.size()];
+			Child& child = children[i];
+			child.emu.emplace(parent.emu.fork()); // shares memory pages until this branch writes one
+			for (int f = 0; f < framesPerInput; f++) child.emu->frame(actions[i % actions.size()]);
+
+			// only a lookup here, the frontier cut below decides what gets marked as seen
+			child.hash = child.emu->hash();
+			if (seen.contains(child.hash)) {
+				duplicates.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			child.keep = true;
+			child.goal = goal(*child.emu);
+		});
+		result.expanded += count;
+		result.duplicates += duplicates.load();
+
+		// collect survivors in index order, shallower and lower numbered inputs win the frontier
+		std::vector<Node> next;
+		for (size_t i = 0; i < count; i++) {
+			Child& child = children[i];
+			if (!child.keep) continue;
+
+			if (!child.goal && next.size() >= config.maxFrontier) continue; // dropped, still reachable by another path
+			if (!seen.insert(child.hash)) { result.duplicates++; continue; } // reached twice at this depth
+
+			steps.push_back({ frontier[i / actions.size()].step, actions[i % actions.size()] });
+			if (child.goal) {
+				result.found = true;
+				for (int s = (int)steps.size() - 1; s >= 0; s = steps[s].parent) result.inputs.push_back(steps[s].input);
+				std::reverse(result.inputs.begin(), result.inputs.end());
+				return result;
+			}
+
+			next.push_back({ std::move(*child.emu), (int)steps.size() - 1 });
+		}
+		frontier = std::move(next);
+	}
+
+	return result;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "core.h"
+
+/***** input search *****/
+
+// fixed size open addressing set of state hashes shared by all search threads.
+// inserts are a single compare and swap, nothing is ever removed, so only
+// states that are actually kept may go in.
+class TranspositionTable {
+public:
+	explicit TranspositionTable(size_t size) {
+		size_t capacity = 1;
+		while (capacity < size) capacity <<= 1;
+		slots = std::make_unique<std::atomic<uint64_t>[]>(capacity);
+		for (size_t i = 0; i < capacity; i++) slots[i].store(0, std::memory_order_relaxed);
+		mask = capacity - 1;
+	}
+
+	// true if the hash was not in the table yet. a full neighbourhood counts as
+	// new so a crowded table only costs duplicate work, never a missed state.
+	bool insert(uint64_t hash) {
+		if (hash == 0) hash = 1; // 0 marks an empty slot
+		for (size_t probe = 0, i = hash & mask; probe < MAX_PROBES; probe++, i = (i + 1) & mask) {
+			uint64_t seen = slots[i].load(std::memory_order_relaxed);
+			if (seen == hash) return false;
+			if (seen == 0) {
+				if (slots[i].compare_exchange_strong(seen, hash, std::memory_order_relaxed)) return true;
+				if (seen == hash) return false;
+			}
+		}
+		return true;
+	}
+
+	bool contains(uint64_t hash) const {
+		if (hash == 0) hash = 1;
+		for (size_t probe = 0, i = hash & mask; probe < MAX_PROBES; probe++, i = (i + 1) & mask) {
+			uint64_t seen = slots[i].load(std::memory_order_relaxed);
+			if (seen == hash) return true;
+			if (seen == 0) return false;
+		}
+		return false;
+	}
+
+private:
+	static const size_t MAX_PROBES = 32;
+	std::unique_ptr<std::atomic<uint64_t>[]> slots;
+	size_t mask = 0;
+};
+
+struct SearchConfig {
+	std::vector<uint16_t> actions; // key masks tried at every step, empty for no keys plus each single key
+	int framesPerInput = 1; // frames each input is held for
+	int maxDepth = 600; // inputs before giving up
+	size_t maxFrontier = 1 << 16; // states kept per depth, extra states are dropped
+	size_t tableSize = 1 << 22; // transposition table slots
+	int threads = 0; // 0 for one per core
+};
+
+struct SearchResult {
+	bool found = false;
+	std::vector<uint16_t> inputs; // one key mask per input, each held framesPerInput frames
+	size_t expanded = 0; // states emulated
+	size_t duplicates = 0; // states dropped by the transposition table
+};
+
+// breadth first search over input sequences starting from `start`, stops at the
+// shallowest state where goal() holds. goal is called from worker threads.
+SearchResult searchInputs(const c8ke& start, const SearchConfig& config, const std::function<bool(const c8ke&)>& goal);
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <string>
+
+#if defined(_WIN32)
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <unistd.h>
+#endif
+
+#include "core.h"
+#include "c8ke_shm.h"
+
+/***** shared state *****/
+
+// writer side of c8ke_shm.h. publish() is a handful of plain stores and a 64KB
+// copy between two sequence bumps, readers in other processes retry if they
+// catch it halfway.
+class SharedState {
+public:
+	~SharedState() { close(); }
+
+	bool open(std::string name) {
+		close();
+#if defined(_WIN32)
+		mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(c8ke_shm), name.c_str());
+		if (!mapping) return false;
+		state = (c8ke_shm*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(c8ke_shm));
+		if (!state) { CloseHandle(mapping); mapping = nullptr; return false; }
+#else
+		if (name.empty() || name[0] != '/') name = "/" + name;
+		int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+		if (fd < 0) return false;
+		void* mapped = (ftruncate(fd, sizeof(c8ke_shm)) == 0) ? mmap(nullptr, sizeof(c8ke_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+		::close(fd); // the mapping keeps the segment alive
+		if (mapped == MAP_FAILED) { shm_unlink(name.c_str()); return false; }
+		state = (c8ke_shm*)mapped;
+		path = name;
+#endif
+		std::memset(state, 0, sizeof(c8ke_shm));
+		state->magic = C8KE_SHM_MAGIC;
+		state->version = C8KE_SHM_VERSION;
+		state->size = sizeof(c8ke_shm);
+		return true;
+	}
+
+	void close() {
+		if (!state) return;
+#if defined(_WIN32)
+		UnmapViewOfFile(state);
+		CloseHandle(mapping);
+		mapping = nullptr;
+#else
+		munmap(state, sizeof(c8ke_shm));
+		shm_unlink(path.c_str());
+#endif
+		state = nullptr;
+	}
+
+	bool active() const { return state != nullptr; }
+
+	// once per frame, after the timers ticked
+	void publish(const c8ke& emu) {
+		if (!state) return;
+		uint32_t sequence = state->sequence;
+		state->sequence = sequence + 1;
+		std::atomic_thread_fence(std::memory_order_release); // odd before any field changes
+
+		state->frame++;
+		state->pc = emu.pc;
+		state->i = emu.iReg;
+		state->sp = emu.sp;
+		state->delay_timer = emu.delayReg;
+		state->sound_timer = emu.soundReg;
+		state->waiting = emu.waiting;
+		std::memcpy(state->regs, emu.regs, sizeof(state->regs));
+		std::memcpy(state->stack, emu.stack, sizeof(state->stack));
+		uint16_t keys = 0;
+		for (int k = 0; k < 16; k++) keys |= (uint16_t)emu.input[k] << k;
+		state->keys = keys;
+		emu.mem.copyTo(state->mem, 0, sizeof(state->mem));
+		emu.mem.copyTo(state->high_mem, sizeof(state->mem), sizeof(state->high_mem));
+		for (int y = 0; y < HEIGHT; y++) {
+			uint64_t row = emu.loresRow(y);
+			for (int x = 0; x < WIDTH; x++) state->pixels[y][x] = (row >> (WIDTH - 1 - x)) & 1;
+		}
+		state->width = (uint16_t)emu.width();
+		state->height = (uint16_t)emu.height();
+		state->planes = emu.planes;
+		state->platform = emu.platform;
+		for (int y = 0; y < HIRES_HEIGHT; y++) {
+			for (int x = 0; x < HIRES_WIDTH; x++) state->display[y][x] = emu.color(x, y); // lores leaves the rest of the rows blank
+		}
+
+		std::atomic_thread_fence(std::memory_order_release); // every field before the even value
+		state->sequence = sequence + 2;
+	}
+
+private:
+	c8ke_shm* state = nullptr;
+#if defined(_WIN32)
+	HANDLE mapping = nullptr;
+#else
+	std::string path;
+#endif
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/***** host timeline *****/
+
+// timing zones for the host side of the emulator (event pumping, rendering,
+// audio), dumped as chrome trace-event json for chrome://tracing or perfetto.
+// every thread records into its own fixed ring, so recording costs two clock
+// reads and a store per zone and the newest zones win once a ring is full.
+class Timeline {
+public:
+	struct Zone {
+		const char* name; // string literal, only the pointer is kept
+		int64_t start; // ns since the timeline was created
+		int64_t end;
+	};
+
+	Timeline() : epoch(std::chrono::steady_clock::now()) {}
+
+	bool recording() const { return active.load(std::memory_order_relaxed); }
+	void record(bool on) { active.store(on, std::memory_order_relaxed); }
+
+	int64_t now() const {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+	}
+
+	void add(const char* name, int64_t start, int64_t end) {
+		static thread_local Buffer* local = nullptr;
+		if (!local) local = registerThread();
+
+		uint64_t n = local->count.load(std::memory_order_relaxed);
+		local->zones[n & (BUFFER_SIZE - 1)] = { name, start, end };
+		local->count.store(n + 1, std::memory_order_release);
+	}
+
+	// drops everything recorded so far, threads keep their buffers
+	void clear() {
+		std::lock_guard<std::mutex> guard(lock);
+		for (auto& buffer : buffers) buffer->count.store(0, std::memory_order_relaxed);
+	}
+
+	// "X" complete events, one tid per recording thread. a thread that is still
+	// recording while this runs can overwrite its oldest zones underneath us,
+	// which only ever garbles zones that were about to be dropped anyway.
+	bool write(const std::string& path) {
+		std::ofstream out(path);
+		if (!out.is_open()) return false;
+
+		std::lock_guard<std::mutex> guard(lock);
+		char line[256];
+		bool first = true;
+		out << "{\"traceEvents\":[\n";
+		for (size_t t = 0; t < buffers.size(); t++) {
+			const Buffer& buffer = *buffers[t];
+			std::snprintf(line, sizeof(line), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":\"%s\"}}",
+				first ? "" : ",\n", t + 1, t == 0 ? "main" : "worker");
+			out << line;
+			first = false;
+
+			uint64_t count = buffer.count.load(std::memory_order_acquire);
+			uint64_t oldest = (count > BUFFER_SIZE) ? count - BUFFER_SIZE : 0;
+			for (uint64_t i = oldest; i < count; i++) {
+				const Zone& zone = buffer.zones[i & (BUFFER_SIZE - 1)];
+				std::snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f}",
+					zone.name, t + 1, zone.start / 1000.0, (zone.end - zone.start) / 1000.0);
+				out << line;
+			}
+		}
+		out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+		return true;
+	}
+
+private:
+	static const size_t BUFFER_SIZE = 1 << 16; // zones per thread, about a minute and a half of the main loop
+
+	struct Buffer {
+		std::unique_ptr<Zone[]> zones{ new Zone[BUFFER_SIZE] };
+		std::atomic<uint64_t> count{ 0 };
+	};
+
+	Buffer* registerThread() {
+		std::lock_guard<std::mutex> guard(lock);
+		buffers.push_back(std::make_unique<Buffer>());
+		return buffers.back().get();
+	}
+
+	std::chrono::steady_clock::time_point epoch;
+	std::atomic<bool> active{ false };
+	std::mutex lock; // guards the buffer list, not the zones
+	std::vector<std::unique_ptr<Buffer>> buffers;
+};
+
+inline Timeline timeline;
+
+// records the enclosing scope as one zone while the timeline is recording
+class ScopedZone {
+public:
+	explicit ScopedZone(const char* name) : name(name), start(timeline.recording() ? timeline.now() : -1) {}
+	~ScopedZone() { end(); }
+
+	// closes the zone early, for phases that don't have a scope of their own
+	void end() {
+		if (start >= 0) timeline.add(name, start, timeline.now());
+		start = -1;
+	}
+
+	// for scopes that turned out to do nothing, keeps idle loop spins out of the timeline
+	void discard() { start = -1; }
+
+	ScopedZone(const ScopedZone&) = delete;
+	ScopedZone& operator=(const ScopedZone&) = delete;
+
+private:
+	const char* name;
+	int64_t start;
+};
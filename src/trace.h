@@ -0,0 +1,283 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core.h"
+
+/***** execution trace *****/
+
+// one retired instruction as the emulator thread hands it over
+struct TraceRecord {
+	uint64_t cycle;
+	word pc; // address the instruction was fetched from
+	word instruction;
+	word iReg; // after the instruction
+	byte regs[16]; // after the instruction
+};
+
+// single producer / single consumer ring. the emulator only ever touches head
+// and the flush thread only ever touches tail, so neither side takes a lock.
+class TraceRing {
+public:
+	explicit TraceRing(size_t size) {
+		size_t capacity = 1;
+		while (capacity < size) capacity <<= 1;
+		records.resize(capacity);
+		mask = capacity - 1;
+	}
+
+	bool push(const TraceRecord& record) {
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) > mask) return false; // full
+		records[h & mask] = record;
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	// hands out up to max records, call release() once they are consumed
+	size_t peek(const TraceRecord*& first, size_t max) const {
+		size_t t = tail.load(std::memory_order_relaxed);
+		size_t available = head.load(std::memory_order_acquire) - t;
+		size_t contiguous = records.size() - (t & mask); // stop at the wrap point
+		first = &records[t & mask];
+		return std::min(std::min(available, contiguous), max);
+	}
+
+	void release(size_t count) {
+		tail.store(tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+	}
+
+private:
+	std::vector<TraceRecord> records;
+	size_t mask = 0;
+	alignas(64) std::atomic<size_t> head{ 0 };
+	alignas(64) std::atomic<size_t> tail{ 0 };
+};
+
+// trace files start with this, then one packed record per instruction:
+//   flags byte
+//   bit 0: cycle didn't advance by 1, varint delta follows
+//   bit 1: pc isn't the previous pc + 2, u16 pc follows
+//   bit 2: instruction differs from the last one seen at this pc, u16 follows
+//   bit 3: i changed, u16 follows
+//   bit 4: registers changed, u16 mask then one byte per set bit
+// the decoder mirrors the same state, so a tight loop costs 1-4 bytes per step.
+const char TRACE_MAGIC[4] = { 'C', '8', 'K', 'T' };
+const byte TRACE_VERSION = 1;
+
+enum TraceFlags {
+	TRACE_CYCLE = 1 << 0,
+	TRACE_PC = 1 << 1,
+	TRACE_INSTRUCTION = 1 << 2,
+	TRACE_IREG = 1 << 3,
+	TRACE_REGS = 1 << 4,
+};
+
+// state shared by the encoder and decoder
+struct TraceModel {
+	uint64_t cycle = 0;
+	word pc = 0;
+	word iReg = 0;
+	byte regs[16]{};
+	word instructions[MAX_MEM]{};
+	bool started = false;
+};
+
+class TraceEncoder {
+public:
+	void encode(const TraceRecord& r, std::string& out) {
+		byte flags = 0;
+		if (r.cycle != model.cycle + 1) flags |= TRACE_CYCLE;
+		if (!model.started || r.pc != (word)(model.pc + 2)) flags |= TRACE_PC;
+		if (r.instruction != model.instructions[r.pc & (MAX_MEM - 1)]) flags |= TRACE_INSTRUCTION;
+		if (r.iReg != model.iReg) flags |= TRACE_IREG;
+
+		word changed = 0;
+		for (int i = 0; i < 16; i++) if (r.regs[i] != model.regs[i]) changed |= 1 << i;
+		if (changed) flags |= TRACE_REGS;
+
+		out += (char)flags;
+		if (flags & TRACE_CYCLE) putVarint(out, r.cycle - model.cycle);
+		if (flags & TRACE_PC) putWord(out, r.pc);
+		if (flags & TRACE_INSTRUCTION) putWord(out, r.instruction);
+		if (flags & TRACE_IREG) putWord(out, r.iReg);
+		if (flags & TRACE_REGS) {
+			putWord(out, changed);
+			for (int i = 0; i < 16; i++) if (changed & (1 << i)) out += (char)r.regs[i];
+		}
+
+		model.cycle = r.cycle;
+		model.pc = r.pc;
+		model.instructions[r.pc & (MAX_MEM - 1)] = r.instruction;
+		model.iReg = r.iReg;
+		std::memcpy(model.regs, r.regs, sizeof(model.regs));
+		model.started = true;
+	}
+
+private:
+	static void putVarint(std::string& out, uint64_t value) {
+		while (value >= 0x80) { out += (char)((value & 0x7F) | 0x80); value >>= 7; }
+		out += (char)value;
+	}
+
+	static void putWord(std::string& out, word value) {
+		out += (char)(value & 0xFF);
+		out += (char)(value >> 8);
+	}
+
+	TraceModel model;
+};
+
+// decoded record, changed lists the registers this instruction wrote
+struct TraceEntry {
+	uint64_t cycle = 0;
+	word pc = 0;
+	word instruction = 0;
+	word iReg = 0;
+	word changed = 0; // bit n = Vn changed
+	byte regs[16]{};
+};
+
+class TraceReader {
+public:
+	bool open(const std::string& path) {
+		file.open(path, std::ios::binary);
+		char magic[4];
+		if (!file.read(magic, 4) || std::memcmp(magic, TRACE_MAGIC, 4) != 0) return false;
+		return file.get() == TRACE_VERSION;
+	}
+
+	bool next(TraceEntry& entry) {
+		int flags = file.get();
+		if (flags == EOF) return false;
+
+		entry.cycle = model.cycle + 1;
+		entry.pc = model.pc + 2;
+		if (flags & TRACE_CYCLE) entry.cycle = model.cycle + getVarint();
+		if (flags & TRACE_PC) entry.pc = getWord();
+		entry.instruction = (flags & TRACE_INSTRUCTION) ? getWord() : model.instructions[entry.pc & (MAX_MEM - 1)];
+		entry.iReg = (flags & TRACE_IREG) ? getWord() : model.iReg;
+		entry.changed = (flags & TRACE_REGS) ? getWord() : 0;
+		std::memcpy(entry.regs, model.regs, sizeof(entry.regs));
+		for (int i = 0; i < 16; i++) if (entry.changed & (1 << i)) entry.regs[i] = (byte)file.get();
+		if (!file) return false; // truncated record
+
+		model.cycle = entry.cycle;
+		model.pc = entry.pc;
+		model.instructions[entry.pc & (MAX_MEM - 1)] = entry.instruction;
+		model.iReg = entry.iReg;
+		std::memcpy(model.regs, entry.regs, sizeof(model.regs));
+		return true;
+	}
+
+private:
+	uint64_t getVarint() {
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			int b = file.get();
+			if (b == EOF) break;
+			value |= (uint64_t)(b & 0x7F) << shift;
+			if (!(b & 0x80)) break;
+		}
+		return value;
+	}
+
+	word getWord() {
+		int lo = file.get();
+		int hi = file.get();
+		return (word)((lo & 0xFF) | ((hi & 0xFF) << 8));
+	}
+
+	std::ifstream file;
+	TraceModel model;
+};
+
+// cycle() probe that streams every retired instruction to a trace file. the
+// emulator thread only copies 32 bytes into the ring, a background thread
+// encodes and writes. if the writer falls behind the emulator waits rather
+// than dropping records, a trace with holes is useless for diffing.
+class TraceWriter : public NoProbe {
+public:
+	explicit TraceWriter(size_t ringSize = 1 << 16) : ring(ringSize) {}
+
+	~TraceWriter() { stop(); }
+
+	bool start(const std::string& path) {
+		stop();
+		file.open(path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) return false;
+		file.write(TRACE_MAGIC, 4);
+		file.put((char)TRACE_VERSION);
+
+		encoder = std::make_unique<TraceEncoder>();
+		cycles = 0;
+		stalls = 0;
+		running.store(true);
+		flusher = std::thread([this] { flush(); });
+		return true;
+	}
+
+	void stop() {
+		if (!flusher.joinable()) return;
+		running.store(false);
+		flusher.join();
+		file.close();
+	}
+
+	bool active() const { return flusher.joinable(); }
+	uint64_t recorded() const { return cycles; }
+	uint64_t stalled() const { return stalls; }
+
+	void execute(word pc, word instruction) {
+		current.pc = pc;
+		current.instruction = instruction;
+	}
+
+	void retire(const c8ke& emu) {
+		current.cycle = ++cycles;
+		current.iReg = emu.iReg;
+		std::memcpy(current.regs, emu.regs, sizeof(current.regs));
+		while (!ring.push(current)) {
+			stalls++;
+			std::this_thread::yield();
+		}
+	}
+
+private:
+	void flush() {
+		std::string out;
+		for (;;) {
+			bool stopping = !running.load();
+			const TraceRecord* first = nullptr;
+			size_t count = ring.peek(first, 4096);
+			if (count == 0) {
+				if (stopping) break;
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				continue;
+			}
+
+			out.clear();
+			for (size_t i = 0; i < count; i++) encoder->encode(first[i], out);
+			ring.release(count);
+			file.write(out.data(), out.size());
+		}
+		file.flush();
+	}
+
+	TraceRing ring;
+	TraceRecord current{};
+	std::unique_ptr<TraceEncoder> encoder; // 128KB of model state, kept off the stack
+	std::ofstream file;
+	std::thread flusher;
+	std::atomic<bool> running{ false };
+	uint64_t cycles = 0;
+	uint64_t stalls = 0;
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// built on any x86 target and picked at run time, x64 only guarantees sse2
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#include <tmmintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+		#define C8KE_TARGET_SSSE3
+	#else
+		#define C8KE_TARGET_SSSE3 __attribute__((target("ssse3")))
+	#endif
+	#define C8KE_SSSE3 1
+#endif
+
+#include "core.h"
+
+/***** palette expansion *****/
+
+// turns the bitplanes into rgba texels. a pixel's palette index is one bit
+// from each plane, the palette is 16 colors packed as r, g, b, a bytes in
+// memory order (SDL_PIXELFORMAT_RGBA32). only the width x height the current
+// mode uses is written, pitch is in pixels.
+inline void toRgbaScalar(const c8ke& emu, const uint32_t palette[16], uint32_t* out, int pitch) {
+	int width = emu.width(), height = emu.height();
+	for (int y = 0; y < height; y++) {
+		uint32_t* line = out + y * pitch;
+		for (int x = 0; x < width; x++) line[x] = palette[emu.color(x, y)];
+	}
+}
+
+#if C8KE_SSSE3
+inline bool hasSsse3() {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 9)) != 0;
+#else
+	return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+// 16 pixels at a time: each plane's 16 bits are spread to one byte per pixel
+// and weighted into the index, then pshufb looks the index up in one table per
+// color channel and the four channels are interleaved back into texels
+C8KE_TARGET_SSSE3 inline void toRgbaSsse3(const c8ke& emu, const uint32_t palette[16], uint32_t* out, int pitch) {
+	alignas(16) byte channels[4][16];
+	for (int i = 0; i < 16; i++) {
+		byte rgba[4];
+		std::memcpy(rgba, &palette[i], 4);
+		for (int c = 0; c < 4; c++) channels[c][i] = rgba[c];
+	}
+	const __m128i r = _mm_load_si128((const __m128i*)channels[0]);
+	const __m128i g = _mm_load_si128((const __m128i*)channels[1]);
+	const __m128i b = _mm_load_si128((const __m128i*)channels[2]);
+	const __m128i a = _mm_load_si128((const __m128i*)channels[3]);
+	const __m128i spread = _mm_setr_epi8(1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0); // high byte holds the leftmost 8 pixels
+	const __m128i bits = _mm_setr_epi8((char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, (char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+
+	int width = emu.width(), height = emu.height();
+	for (int y = 0; y < height; y++) {
+		uint32_t* line = out + y * pitch;
+		for (int x = 0; x < width; x += 16) {
+			int shift = 48 - (x & 63);
+			__m128i index = _mm_setzero_si128();
+			for (int p = 0; p < PLANES; p++) {
+				uint16_t chunk = (uint16_t)(emu.screen[p][y][x >> 6] >> shift);
+				if (!chunk) continue;
+				__m128i lanes = _mm_shuffle_epi8(_mm_set1_epi16((short)chunk), spread);
+				__m128i set = _mm_cmpeq_epi8(_mm_and_si128(lanes, bits), bits);
+				index = _mm_or_si128(index, _mm_and_si128(set, _mm_set1_epi8((char)(1 << p))));
+			}
+
+			__m128i red = _mm_shuffle_epi8(r, index), green = _mm_shuffle_epi8(g, index);
+			__m128i blue = _mm_shuffle_epi8(b, index), alpha = _mm_shuffle_epi8(a, index);
+			__m128i rg = _mm_unpacklo_epi8(red, green), rgHigh = _mm_unpackhi_epi8(red, green);
+			__m128i ba = _mm_unpacklo_epi8(blue, alpha), baHigh = _mm_unpackhi_epi8(blue, alpha);
+			_mm_storeu_si128((__m128i*)(line + x), _mm_unpacklo_epi16(rg, ba));
+			_mm_storeu_si128((__m128i*)(line + x + 4), _mm_unpackhi_epi16(rg, ba));
+			_mm_storeu_si128((__m128i*)(line + x + 8), _mm_unpacklo_epi16(rgHigh, baHigh));
+			_mm_storeu_si128((__m128i*)(line + x + 12), _mm_unpackhi_epi16(rgHigh, baHigh));
+		}
+	}
+}
+
+inline void toRgba(const c8ke& emu, const uint32_t palette[16], uint32_t* out, int pitch) {
+	static const bool ssse3 = hasSsse3();
+	if (ssse3) toRgbaSsse3(emu, palette, out, pitch);
+	else toRgbaScalar(emu, palette, out, pitch);
+}
+#else
+inline void toRgba(const c8ke& emu, const uint32_t palette[16], uint32_t* out, int pitch) {
+	toRgbaScalar(emu, palette, out, pitch);
+}
+#endif
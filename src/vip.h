@@ -0,0 +1,434 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "core.h"
+
+/***** cdp1802 *****/
+
+// the rca 1802 as the vip uses it. every opcode byte has its own handler,
+// instantiated from one template with the I and N nibbles as constants and
+// laid out in a 256 entry table, so an instruction is a fetch, one indirect
+// call and no decoding at run time. bus is whatever owns memory, I/O and the
+// EF lines, its calls inline into the handlers.
+template <class Bus>
+class Cdp1802 {
+public:
+	word r[16]{}; // scratchpad registers
+	byte p{}, x{}; // program counter and data pointer register numbers
+	byte d{}, t{}; // accumulator, saved X and P
+	bool df{}, q{}, ie = true, idle{};
+	uint64_t cycles{}; // machine cycles since reset, 8 clocks each
+	uint64_t instructions{};
+
+	void reset() {
+		std::memset(r, 0, sizeof(r));
+		p = x = d = t = 0;
+		df = q = idle = false;
+		ie = true;
+		cycles = 0;
+		instructions = 0;
+	}
+
+	// one instruction, returns its opcode. two machine cycles, three for the long branches and skips
+	byte step(Bus& bus) {
+		byte op = bus.read(r[p]++);
+		table[op](*this, bus);
+		cycles += (op >> 4) == 0xC ? 3 : 2;
+		instructions++;
+		return op;
+	}
+
+	// one machine cycle, X and P saved in T and the handler runs as P = 1, X = 2
+	void interrupt() {
+		t = (byte)((x << 4) | p);
+		x = 2;
+		p = 1;
+		ie = false;
+		idle = false;
+		cycles++;
+	}
+
+	// one machine cycle, the byte at R0 goes out to the device
+	byte dmaOut(Bus& bus) {
+		byte value = bus.read(r[0]++);
+		idle = false;
+		cycles++;
+		return value;
+	}
+
+private:
+	using Handler = void (*)(Cdp1802&, Bus&);
+
+	void add(byte m, int carry) {
+		int sum = d + m + carry;
+		d = (byte)sum;
+		df = sum > 0xFF;
+	}
+
+	// DF is 1 when there was no borrow
+	void subtract(byte a, byte b, int borrow) {
+		int difference = a - b - borrow;
+		d = (byte)difference;
+		df = difference >= 0;
+	}
+
+	template <int N>
+	bool flag(Bus& bus) const {
+		if constexpr (N == 0) return true;
+		else if constexpr (N == 1) return q;
+		else if constexpr (N == 2) return d == 0;
+		else if constexpr (N == 3) return df;
+		else return bus.ef(N - 3); // EF1-EF4
+	}
+
+	template <int OP>
+	static void execute(Cdp1802& c, Bus& bus) {
+		constexpr int I = OP >> 4, N = OP & 0xF;
+		word& rn = c.r[N];
+		word& pc = c.r[c.p];
+
+		if constexpr (I == 0x0) { // IDL, LDN
+			if constexpr (N == 0) c.idle = true;
+			else c.d = bus.read(rn);
+		} else if constexpr (I == 0x1) { // INC
+			rn++;
+		} else if constexpr (I == 0x2) { // DEC
+			rn--;
+		} else if constexpr (I == 0x3) { // short branches, 38-3F on the inverse condition. 38 is SKP
+			bool taken = c.template flag<N & 7>(bus) != (N >= 8);
+			if (taken) pc = (word)((pc & 0xFF00) | bus.read(pc));
+			else pc++;
+		} else if constexpr (I == 0x4) { // LDA
+			c.d = bus.read(rn++);
+		} else if constexpr (I == 0x5) { // STR
+			bus.write(rn, c.d);
+		} else if constexpr (I == 0x6) { // IRX, OUT 1-7, INP 1-7
+			if constexpr (N == 0) c.r[c.x]++;
+			else if constexpr (N < 8) { bus.out(N, bus.read(c.r[c.x])); c.r[c.x]++; }
+			else if constexpr (N > 8) { c.d = bus.inp(N - 8); bus.write(c.r[c.x], c.d); }
+		} else if constexpr (I == 0x7) {
+			word& rx = c.r[c.x];
+			if constexpr (N == 0x0 || N == 0x1) { // RET, DIS
+				byte v = bus.read(rx++);
+				c.x = v >> 4;
+				c.p = v & 0xF;
+				c.ie = N == 0x0;
+			}
+			else if constexpr (N == 0x2) c.d = bus.read(rx++); // LDXA
+			else if constexpr (N == 0x3) bus.write(rx--, c.d); // STXD
+			else if constexpr (N == 0x4) c.add(bus.read(rx), c.df); // ADC
+			else if constexpr (N == 0x5) c.subtract(bus.read(rx), c.d, !c.df); // SDB
+			else if constexpr (N == 0x6) { bool carry = c.d & 1; c.d = (byte)((c.d >> 1) | (c.df << 7)); c.df = carry; } // SHRC
+			else if constexpr (N == 0x7) c.subtract(c.d, bus.read(rx), !c.df); // SMB
+			else if constexpr (N == 0x8) bus.write(rx, c.t); // SAV
+			else if constexpr (N == 0x9) { c.t = (byte)((c.x << 4) | c.p); bus.write(c.r[2], c.t); c.x = c.p; c.r[2]--; } // MARK
+			else if constexpr (N == 0xA) c.q = false; // REQ
+			else if constexpr (N == 0xB) c.q = true; // SEQ
+			else if constexpr (N == 0xC) c.add(bus.read(pc++), c.df); // ADCI
+			else if constexpr (N == 0xD) c.subtract(bus.read(pc++), c.d, !c.df); // SDBI
+			else if constexpr (N == 0xE) { bool carry = c.d >> 7; c.d = (byte)((c.d << 1) | c.df); c.df = carry; } // SHLC
+			else c.subtract(c.d, bus.read(pc++), !c.df); // SMBI
+		} else if constexpr (I == 0x8) { // GLO
+			c.d = (byte)rn;
+		} else if constexpr (I == 0x9) { // GHI
+			c.d = (byte)(rn >> 8);
+		} else if constexpr (I == 0xA) { // PLO
+			rn = (word)((rn & 0xFF00) | c.d);
+		} else if constexpr (I == 0xB) { // PHI
+			rn = (word)((c.d << 8) | (rn & 0xFF));
+		} else if constexpr (I == 0xC) { // long branches on 0-3 and 9-B, long skips on 5-8 and C-F, C4 is NOP
+			constexpr bool skip = (N >= 0x5 && N <= 0x8) || N >= 0xC;
+			bool condition;
+			if constexpr (N == 0x0 || N == 0x8) condition = true;
+			else if constexpr (N == 0x1 || N == 0xD) condition = c.q;
+			else if constexpr (N == 0x2 || N == 0xE) condition = c.d == 0;
+			else if constexpr (N == 0x3 || N == 0xF) condition = c.df;
+			else if constexpr (N == 0x5 || N == 0x9) condition = !c.q;
+			else if constexpr (N == 0x6 || N == 0xA) condition = c.d != 0;
+			else if constexpr (N == 0x7 || N == 0xB) condition = !c.df;
+			else if constexpr (N == 0xC) condition = c.ie;
+			else condition = false;
+
+			if constexpr (N == 0x4) return;
+			else if constexpr (skip) { if (condition) pc += 2; }
+			else if (condition) pc = (word)((bus.read(pc) << 8) | bus.read((word)(pc + 1)));
+			else pc += 2;
+		} else if constexpr (I == 0xD) { // SEP
+			c.p = N;
+		} else if constexpr (I == 0xE) { // SEX
+			c.x = N;
+		} else { // memory reference and immediate forms of the alu
+			constexpr bool immediate = N >= 8;
+			constexpr int op = N & 7;
+			if constexpr (op == 6) { // SHR, SHL
+				if constexpr (immediate) { c.df = c.d >> 7; c.d = (byte)(c.d << 1); }
+				else { c.df = c.d & 1; c.d >>= 1; }
+				return;
+			} else {
+				byte m = immediate ? bus.read(pc++) : bus.read(c.r[c.x]);
+				if constexpr (op == 0) c.d = m; // LDX, LDI
+				else if constexpr (op == 1) c.d |= m; // OR, ORI
+				else if constexpr (op == 2) c.d &= m; // AND, ANI
+				else if constexpr (op == 3) c.d ^= m; // XOR, XRI
+				else if constexpr (op == 4) c.add(m, 0); // ADD, ADI
+				else if constexpr (op == 5) c.subtract(m, c.d, 0); // SD, SDI
+				else c.subtract(c.d, m, 0); // SM, SMI
+			}
+		}
+	}
+
+	template <size_t... OPS>
+	static constexpr std::array<Handler, 256> makeTable(std::index_sequence<OPS...>) {
+		return { { &execute<(int)OPS>... } };
+	}
+
+	static constexpr std::array<Handler, 256> table = makeTable(std::make_index_sequence<256>());
+};
+
+
+
+/***** cosmac vip *****/
+
+const int VIP_RAM = 0x1000; // 4KB, the usual expanded machine
+const int VIP_ROM = 0x200; // monitor, at 8000 and over 0000 until the first access with A15 set
+const int VIP_LINES = 262; // per frame, 3668 machine cycles like the hle timing model
+const int VIP_LINE_CYCLES = 14;
+const int VIP_DISPLAY_LINE = 80; // first of the 128 lines the 1861 shows
+const int VIP_DISPLAY_LINES = 128;
+const int VIP_INTERRUPT_LINE = 78; // INT is held for the two lines before the display
+const int VIP_DMA_CYCLE = 1; // where in a line its 8 DMA cycles start, 29 cycles after INT
+const double VIP_CYCLES_PER_SECOND = 1760900.0 / 8;
+
+// low level vip: the 1802 running the rca monitor and the original chip8
+// interpreter out of RAM, with the 1861 stealing DMA cycles and raising the
+// vblank interrupt on the same line and cycle as the real chip. neither image
+// ships with c8ke, boot() takes them from files the user dumped.
+//
+// the chip8 state lives where the interpreter keeps it: pc in R5, I in RA,
+// the timers in R8, V0-VF at F0 of the page R6 points into and the screen in
+// the page RB points at.
+class Vip {
+public:
+	Cdp1802<Vip> cpu;
+	byte ram[VIP_RAM]{};
+	byte rom[VIP_ROM]{};
+	byte video[VIP_DISPLAY_LINES][8]{}; // what the 1861 read on each line of the last frame, 4 lines per chip8 row
+	uint16_t keys{}; // held keys, bit n = key n
+	const std::vector<uint16_t>* inputs = nullptr; // key masks per frame, read as each frame starts
+	uint64_t frames{};
+	uint64_t fetches{}; // LDA R5 executed, two per chip8 instruction
+
+	// false if the images are the wrong size
+	bool boot(const std::vector<byte>& monitor, const std::vector<byte>& interpreter, const byte* program, size_t size) {
+		if (monitor.size() != VIP_ROM || interpreter.empty() || interpreter.size() > START_ADDRESS) return false;
+		std::memset(ram, 0, sizeof(ram));
+		std::memset(video, 0, sizeof(video));
+		std::memcpy(rom, monitor.data(), VIP_ROM);
+		std::memcpy(ram, interpreter.data(), interpreter.size());
+		std::memcpy(ram + START_ADDRESS, program, std::min(size, (size_t)(VIP_RAM - START_ADDRESS)));
+		cpu.reset();
+		romShadow = true;
+		displayOn = false;
+		keyLatch = 0;
+		keys = 0;
+		frames = 0;
+		fetches = 0;
+		line = 0;
+		lineStart = 0;
+		dmaDone = false;
+		return true;
+	}
+
+	// one 1802 instruction, or the interrupt, or idling up to the next dma
+	void step() {
+		sync();
+		if (cpu.ie && displayOn && (line == VIP_INTERRUPT_LINE || line == VIP_INTERRUPT_LINE + 1)) {
+			cpu.interrupt();
+			return;
+		}
+		if (cpu.idle) {
+			cpu.cycles = std::max(cpu.cycles, nextEvent());
+			return;
+		}
+		if (cpu.step(*this) == 0x45) fetches++;
+	}
+
+	// one 60 Hz frame
+	void frame() {
+		uint64_t until = frames + 1;
+		while (frames < until) step();
+	}
+
+	// runs until the interpreter is about to fetch a chip8 instruction, the
+	// point where its state is between instructions. the fetch is the pair of
+	// LDA R5 in its main loop. false if frame `until` starts first
+	bool runToFetch(uint64_t until) {
+		while (frames < until) {
+			if (!(fetches & 1) && !cpu.idle && peek(cpu.r[cpu.p]) == 0x45 && !(cpu.ie && interrupting())) return true;
+			step();
+		}
+		return false;
+	}
+
+	// one chip8 instruction, from its fetch to the next one's. false if frame
+	// `until` starts first, as when Fx0A waits for a key nobody presses
+	bool runInstruction(uint64_t until) {
+		uint64_t target = fetches + 2;
+		while (fetches < target && frames < until) step();
+		return fetches >= target && runToFetch(until);
+	}
+
+	word pc() const { return cpu.r[5]; }
+	word index() const { return cpu.r[10]; }
+	byte v(int i) const { return ram[((cpu.r[6] & 0xFF00) | 0xF0 | i) & (VIP_RAM - 1)]; }
+	byte delay() const { return (byte)(cpu.r[8] >> 8); }
+	byte sound() const { return (byte)cpu.r[8]; }
+	bool beeping() const { return cpu.q; }
+
+	// row y of the 64x32 screen in the interpreter's display page, x = 0 in the high bit
+	uint64_t row(int y) const {
+		uint64_t bits = 0;
+		const byte* page = ram + ((cpu.r[11] & 0xFF00) & (VIP_RAM - 1));
+		for (int i = 0; i < 8; i++) bits = (bits << 8) | page[y * 8 + i];
+		return bits;
+	}
+
+	byte peek(word address) const {
+		return (romShadow || (address & 0x8000)) ? rom[address & (VIP_ROM - 1)] : ram[address & (VIP_RAM - 1)];
+	}
+
+	// bus
+	byte read(word address) {
+		if (address & 0x8000) romShadow = false;
+		return peek(address);
+	}
+
+	void write(word address, byte value) {
+		if (!(address & 0x8000)) ram[address & (VIP_RAM - 1)] = value;
+	}
+
+	void out(int port, byte value) {
+		if (port == 1) displayOn = false;
+		else if (port == 2) keyLatch = value & 0xF; // the key EF3 reports
+	}
+
+	byte inp(int port) {
+		if (port == 1) displayOn = true;
+		return 0;
+	}
+
+	bool ef(int n) const {
+		if (n == 1) return (line >= VIP_DISPLAY_LINE - 4 && line < VIP_DISPLAY_LINE) || (line >= VIP_DISPLAY_LINE + VIP_DISPLAY_LINES - 4 && line < VIP_DISPLAY_LINE + VIP_DISPLAY_LINES);
+		if (n == 3) return (keys >> keyLatch) & 1;
+		return false;
+	}
+
+private:
+	bool interrupting() const {
+		return displayOn && (line == VIP_INTERRUPT_LINE || line == VIP_INTERRUPT_LINE + 1);
+	}
+
+	uint64_t nextEvent() const {
+		return lineStart + (dmaDone ? VIP_LINE_CYCLES : VIP_DMA_CYCLE);
+	}
+
+	// catches the 1861 up with the cpu. an instruction that runs into a line's
+	// DMA delays it by a cycle at most, the DMA itself stalls the cpu
+	void sync() {
+		for (;;) {
+			if (!dmaDone && cpu.cycles >= lineStart + VIP_DMA_CYCLE) {
+				dmaDone = true;
+				int visible = line - VIP_DISPLAY_LINE;
+				if (displayOn && visible >= 0 && visible < VIP_DISPLAY_LINES) {
+					for (int i = 0; i < 8; i++) video[visible][i] = cpu.dmaOut(*this);
+				}
+			} else if (cpu.cycles >= lineStart + VIP_LINE_CYCLES) {
+				lineStart += VIP_LINE_CYCLES;
+				dmaDone = false;
+				if (++line == VIP_LINES) {
+					line = 0;
+					frames++;
+					if (inputs) keys = frames < inputs->size() ? (*inputs)[frames] : 0;
+				}
+			} else {
+				break;
+			}
+		}
+	}
+
+	bool romShadow = true;
+	bool displayOn{};
+	byte keyLatch{};
+	int line{};
+	uint64_t lineStart{};
+	bool dmaDone{};
+};
+
+
+
+/***** hle oracle *****/
+
+struct Divergence {
+	bool found = false;
+	uint64_t instructions = 0; // chip8 instructions both ran before it
+	word pc = 0;
+	word instruction = 0;
+	char detail[96]{};
+};
+
+// runs the hle core and the vip in lockstep, one chip8 instruction at a time,
+// until they disagree on pc, I, V0-VF, the screen or memory an instruction
+// wrote. the hle side is handed the vip's timers, keys, Cxkk results and Fx0A
+// keys, so timing and the rngs don't count as differences, only the logic.
+// running out of frames mid instruction ends the run without a divergence
+inline Divergence diffAgainstVip(Vip& vip, c8ke& hle, uint64_t maxFrames) {
+	Divergence result;
+	auto fail = [&](const char* format, auto... args) {
+		result.found = true;
+		result.pc = hle.pc;
+		result.instruction = (word)((hle.mem[hle.pc] << 8) | hle.mem[hle.pc + 1]);
+		std::snprintf(result.detail, sizeof(result.detail), format, args...);
+		return result;
+	};
+
+	if (!vip.runToFetch(maxFrames)) {
+		if (vip.fetches == 0 && maxFrames > 0) return fail("the interpreter never fetched an instruction");
+		return result;
+	}
+	while (vip.frames < maxFrames) {
+		if (hle.pc != vip.pc()) return fail("pc %03X, vip %03X", hle.pc, vip.pc());
+		if (hle.iReg != vip.index()) return fail("I %03X, vip %03X", hle.iReg, vip.index());
+		for (int i = 0; i < 16; i++) {
+			if (hle.regs[i] != vip.v(i)) return fail("V%X %02X, vip %02X", i, hle.regs[i], vip.v(i));
+		}
+		for (int y = 0; y < HEIGHT; y++) {
+			if (hle.screen[0][y][0] != vip.row(y)) return fail("screen row %d", y);
+		}
+
+		word instruction = (word)((hle.mem[hle.pc] << 8) | hle.mem[hle.pc + 1]);
+		word written = hle.iReg;
+		int x = (instruction >> 8) & 0xF;
+		hle.delayReg = vip.delay();
+		hle.soundReg = vip.sound();
+		for (byte k = 0; k < 16; k++) hle.input[k] = (vip.keys >> k) & 1;
+		hle.cycle();
+		if (!vip.runInstruction(maxFrames)) break; // out of frames, the core already ran it so it isn't compared
+
+		if ((instruction & 0xF000) == 0xC000) hle.regs[x] = vip.v(x);
+		if (hle.waiting) { hle.regs[hle.waitReg] = vip.v(hle.waitReg); hle.waiting = false; }
+		int count = (instruction & 0xF0FF) == 0xF033 ? 3 : (instruction & 0xF0FF) == 0xF055 ? x + 1 : 0;
+		for (int i = 0; i < count; i++) {
+			word a = (word)((written + i) & (VIP_RAM - 1));
+			if (hle.mem[a] != vip.ram[a]) return fail("mem[%03X] %02X, vip %02X", a, hle.mem[a], vip.ram[a]);
+		}
+		result.instructions++;
+	}
+	return result;
+}
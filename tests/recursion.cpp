@@ -0,0 +1,42 @@
+// regression check for the call stack bounds, a rom that calls itself must not
+// write past stack[16] into the memory page pointers behind it.
+//   g++ -std=c++17 -fsanitize=address -I../src recursion.cpp -o recursion && ./recursion
+
+#include <cstdio>
+
+#include "core.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+	if (!ok) { std::printf("FAIL %s\n", what); failures++; }
+}
+
+int main() {
+	{ // 2200: call 200 forever
+		c8ke emu;
+		emu.reset(1);
+		const byte rom[] = { 0x22, 0x00 };
+		emu.load(rom, sizeof(rom));
+		for (int i = 0; i < 40; i++) {
+			emu.cycle();
+			check(emu.sp < 16, "2nnn keeps sp within the stack");
+		}
+		c8ke fork = emu.fork(); // shares the pages, both release them on the way out
+		check(fork.mem[START_ADDRESS] == 0x22, "memory pages survive the recursion");
+	}
+	{ // 00EE with nothing to return to
+		c8ke emu;
+		emu.reset(1);
+		const byte rom[] = { 0x00, 0xEE };
+		emu.load(rom, sizeof(rom));
+		for (int i = 0; i < 40; i++) {
+			emu.pc = START_ADDRESS;
+			emu.cycle();
+			check(emu.sp == 0xFF || emu.sp < 16, "00EE keeps sp within the stack");
+		}
+	}
+
+	std::printf(failures ? "recursion: %d failures\n" : "recursion: ok\n", failures);
+	return failures ? 1 : 0;
+}